@@ -0,0 +1,116 @@
+#include "alloc_stats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <pugixml.hpp>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+    std::atomic<bool> tracking{ false };
+    thread_local AllocCounters counters;
+
+    size_t blockSize(void* p) {
+#if defined(_WIN32)
+        return _msize(p);
+#elif defined(__APPLE__)
+        return malloc_size(p);
+#else
+        return malloc_usable_size(p);
+#endif
+    }
+
+    void* allocate(size_t size) {
+        void* p = std::malloc(size ? size : 1);
+        if (p && tracking.load(std::memory_order_relaxed)) {
+            counters.allocations++;
+            counters.bytes += size;
+            counters.live += blockSize(p);
+            if (counters.live > counters.peakLive) counters.peakLive = counters.live;
+        }
+        return p;
+    }
+
+    void release(void* p) {
+        if (!p) return;
+        if (tracking.load(std::memory_order_relaxed)) {
+            counters.live -= blockSize(p);
+        }
+        std::free(p);
+    }
+
+    // Aligned blocks are not counted: nothing in the parser asks for them,
+    // and their size cannot be read back portably.
+    void* allocateAligned(size_t size, std::align_val_t align) {
+#ifdef _WIN32
+        return _aligned_malloc(size ? size : 1, static_cast<size_t>(align));
+#else
+        size_t alignment = static_cast<size_t>(align);
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+    }
+
+    void releaseAligned(void* p) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+    void* allocateOrThrow(size_t size) {
+        void* p = allocate(size);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    void* allocateAlignedOrThrow(size_t size, std::align_val_t align) {
+        void* p = allocateAligned(size, align);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+}
+
+namespace alloc_stats {
+    void enable() {
+        // pugixml allocates its tree with malloc unless told otherwise.
+        pugi::set_memory_management_functions(allocate, release);
+        tracking = true;
+    }
+
+    bool enabled() {
+        return tracking.load(std::memory_order_relaxed);
+    }
+
+    AllocCounters& threadCounters() {
+        return counters;
+    }
+}
+
+void* operator new(size_t size) { return allocateOrThrow(size); }
+void* operator new[](size_t size) { return allocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+
+void* operator new(size_t size, std::align_val_t align) { return allocateAlignedOrThrow(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return allocateAlignedOrThrow(size, align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocateAligned(size, align); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocateAligned(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { releaseAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(p); }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap use seen on one thread, counted by the global operator new/delete
+// replacements in alloc_stats.cpp and by pugixml's allocator hooks.
+// Live bytes go negative when a thread frees what another one allocated;
+// only differences are meaningful.
+struct AllocCounters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    int64_t live = 0;
+    int64_t peakLive = 0;
+};
+
+// What one stretch of work allocated. peakLive is the most it had live at
+// once on top of what was live when it started, retained what was still
+// live at the end.
+struct AllocUsage {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t peakLive = 0;
+    uint64_t retained = 0;
+
+    // Sums the counts, keeps the larger peak and retained size.
+    void add(const AllocUsage& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        if (other.peakLive > peakLive) peakLive = other.peakLive;
+        if (other.retained > retained) retained = other.retained;
+    }
+};
+
+namespace alloc_stats {
+    // Off by default: until enabled, the hooks only test a flag.
+    void enable();
+    bool enabled();
+
+    AllocCounters& threadCounters();
+}
+
+// Measures the calling thread's allocations from construction to stop().
+// Meters nest: an outer meter still sees the peaks of inner ones.
+class AllocMeter {
+private:
+    AllocCounters& counters;
+    uint64_t startAllocations;
+    uint64_t startBytes;
+    int64_t startLive;
+    int64_t outerPeak;
+
+public:
+    AllocMeter() : counters(alloc_stats::threadCounters()), startAllocations(counters.allocations),
+        startBytes(counters.bytes), startLive(counters.live), outerPeak(counters.peakLive) {
+        counters.peakLive = counters.live;
+    }
+    AllocMeter(const AllocMeter&) = delete;
+    AllocMeter& operator=(const AllocMeter&) = delete;
+
+    ~AllocMeter() {
+        if (counters.peakLive < outerPeak) counters.peakLive = outerPeak;
+    }
+
+    AllocUsage stop() {
+        AllocUsage usage;
+        usage.allocations = counters.allocations - startAllocations;
+        usage.bytes = counters.bytes - startBytes;
+        usage.peakLive = counters.peakLive > startLive ? static_cast<uint64_t>(counters.peakLive - startLive) : 0;
+        usage.retained = counters.live > startLive ? static_cast<uint64_t>(counters.live - startLive) : 0;
+        return usage;
+    }
+};
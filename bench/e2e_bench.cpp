@@ -0,0 +1,443 @@
+// End-to-end throughput of the recap_parser CLI over a corpus, usually one
+// written by recap_corpus_gen, in every export mode (none, XML, YAML) with one
+// worker and with one per core.
+//
+//   recap_bench_e2e --cli <recap_parser> --corpus <dir> [--baseline <json>]
+//                   [--threshold PCT] [--rss-threshold PCT] [--rounds N]
+//                   [--json <out>] [--write-baseline <out>]
+//                   [--alloc-corpora <short dir> <long dir>]
+//
+// For each mode and file type the CLI is run on that type's files through
+// --files-from, best of --rounds, giving files/s, MB/s and the child's peak
+// RSS; an "all" row runs the whole corpus in one invocation. The CLI reports
+// no per-file timings, so p50/p99 latency comes from converting each file
+// in-process with the same read, Parser and exporter calls and thread count,
+// again keeping each file's best round.
+//
+// With --baseline, any metric worse than the baseline by more than the
+// threshold is listed and the exit code is 1. Baselines are only comparable
+// on the machine that recorded them; refresh with --write-baseline.
+//
+// Last, with --alloc-corpora, two corpora that differ only in array and
+// string lengths are decoded without export under --track-allocs. Decoding
+// must not allocate per field: any file type that allocates more on the long
+// corpus than on the short one also gives exit code 1.
+
+#include <CLI/CLI.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include "catalog.h"
+#include "package.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+    struct CorpusFile {
+        fs::path path;
+        uint64_t size = 0;
+    };
+
+    struct Mode {
+        std::string format;
+        unsigned threads;
+        std::string name;
+    };
+
+    struct Metrics {
+        size_t files = 0;
+        uint64_t bytes = 0;
+        double filesPerSecond = 0;
+        double megabytesPerSecond = 0;
+        double p50Ms = 0;
+        double p99Ms = 0;
+        long peakRssKb = 0;
+    };
+
+    // mode name -> row label ("all" or a file type) -> metrics
+    using Results = std::map<std::string, std::map<std::string, Metrics>>;
+
+    struct CliRun {
+        bool ok = false;
+        double seconds = 0;
+        long peakRssKb = 0;
+    };
+
+    CliRun runCli(const std::vector<std::string>& args) {
+        std::vector<char*> argv;
+        for (const auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        CliRun run;
+        auto started = std::chrono::steady_clock::now();
+        pid_t pid;
+        int spawned = posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (spawned != 0) {
+            return run;
+        }
+        int status = 0;
+        struct rusage usage {};
+        if (wait4(pid, &status, 0, &usage) < 0) {
+            return run;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        run.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        run.seconds = elapsed.count();
+        run.peakRssKb = usage.ru_maxrss;
+        return run;
+    }
+
+    // Per-file time to read, decode and export, as the CLI's workers do it.
+    std::vector<double> measureLatencies(const Catalog& catalog, const std::vector<CorpusFile>& files,
+        const Mode& mode, const fs::path& outDir) {
+        std::vector<double> latencies(files.size(), 0);
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            std::vector<char> data;
+            for (size_t i = next++; i < files.size(); i = next++) {
+                auto started = std::chrono::steady_clock::now();
+                if (readWholeFile(files[i].path.string(), data)) {
+                    Parser parser(catalog, files[i].path.string(), true, false, mode.format);
+                    if (parser.parse(data.data(), data.size()) && mode.format != "none") {
+                        parser.exportToFile((outDir / fmt::format("{}.{}", i, mode.format)).string());
+                    }
+                }
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+                latencies[i] = elapsed.count();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < mode.threads; t++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return latencies;
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) {
+            return 0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t rank = static_cast<size_t>(fraction * (values.size() - 1) + 0.5);
+        return values[std::min(rank, values.size() - 1)];
+    }
+
+    std::string label(const fs::path& path) {
+        std::string ext = path.extension().string();
+        std::string name = ext.empty() ? path.filename().string() : ext.substr(1);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return name;
+    }
+
+    void writeJson(const std::string& path, const Results& results, const std::vector<Mode>& modes) {
+        std::ofstream out(path);
+        out << "{\n  \"modes\": {";
+        bool firstMode = true;
+        for (const auto& mode : modes) {
+            auto rows = results.find(mode.name);
+            if (rows == results.end()) continue;
+            out << (firstMode ? "\n" : ",\n") << fmt::format("    \"{}\": {{\n      \"threads\": {},\n      \"types\": {{", mode.name, mode.threads);
+            firstMode = false;
+            bool firstRow = true;
+            for (const auto& [name, m] : rows->second) {
+                out << (firstRow ? "\n" : ",\n");
+                firstRow = false;
+                out << fmt::format("        \"{}\": {{ \"files\": {}, \"bytes\": {}, \"files_per_s\": {:.1f}, \"mb_per_s\": {:.2f}, "
+                    "\"p50_ms\": {:.4f}, \"p99_ms\": {:.4f}, \"peak_rss_kb\": {} }}",
+                    name, m.files, m.bytes, m.filesPerSecond, m.megabytesPerSecond, m.p50Ms, m.p99Ms, m.peakRssKb);
+            }
+            out << "\n      }\n    }";
+        }
+        out << "\n  }\n}\n";
+    }
+
+    // Decodes a corpus without export under --track-allocs; the per file type
+    // rows of the --stats report, or a null node if the run failed.
+    YAML::Node decodeAllocations(const std::string& cliPath, const std::string& gameVersion,
+        const fs::path& corpusDir, const fs::path& workDir, const std::string& name) {
+        fs::path listPath = workDir / (name + ".list");
+        fs::path statsPath = workDir / (name + ".json");
+        {
+            std::ofstream list(listPath);
+            std::error_code ec;
+            for (auto it = fs::recursive_directory_iterator(corpusDir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                if (it->is_regular_file(ec)) list << fs::absolute(it->path()).string() << "\n";
+            }
+        }
+        if (!runCli({ cliPath, "--files-from", listPath.string(), "-j", "1", "--silent", "--gv", gameVersion,
+            "--track-allocs", "--stats", statsPath.string() }).ok) {
+            std::cerr << "recap_parser failed in the allocation check on " << corpusDir << "\n";
+            return YAML::Node();
+        }
+        try {
+            return YAML::LoadFile(statsPath.string())["types"];
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Cannot read " << statsPath << ": " << e.what() << "\n";
+            return YAML::Node();
+        }
+    }
+
+    // The two corpora hold the same files with longer arrays and strings in
+    // the second, so the setup of the parser and the file read cost the same
+    // on both. Any decode allocation per field shows up as more allocations
+    // on the long corpus.
+    int checkAllocations(const YAML::Node& shortTypes, const YAML::Node& longTypes) {
+        if (!shortTypes || !longTypes) {
+            return 2;
+        }
+        int failures = 0;
+        size_t compared = 0;
+        for (const auto& entry : shortTypes) {
+            const std::string type = entry.first.as<std::string>();
+            YAML::Node other = longTypes[type];
+            if (!other || other["files"].as<uint64_t>() != entry.second["files"].as<uint64_t>()) {
+                failures++;
+                std::cout << fmt::format("ALLOCATIONS {}: the corpora hold different files\n", type);
+                continue;
+            }
+            compared++;
+            uint64_t shortAllocations = entry.second["decode_allocs"]["allocations"].as<uint64_t>();
+            uint64_t longAllocations = other["decode_allocs"]["allocations"].as<uint64_t>();
+            if (longAllocations > shortAllocations) {
+                failures++;
+                std::cout << fmt::format("ALLOCATIONS {}: {} decode allocation(s) over {} field(s), {} over {}\n", type,
+                    shortAllocations, entry.second["fields"].as<uint64_t>(), longAllocations, other["fields"].as<uint64_t>());
+            }
+        }
+        std::cout << fmt::format("Allocation check: {} type(s) compared, {} allocate per field\n", compared, failures);
+        return failures > 0 ? 1 : 0;
+    }
+
+    // Lists every metric that is worse than the baseline by more than its threshold.
+    int compare(const std::string& baselinePath, const Results& results, double threshold, double rssThreshold) {
+        YAML::Node baseline;
+        try {
+            baseline = YAML::LoadFile(baselinePath);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Cannot read baseline " << baselinePath << ": " << e.what() << "\n";
+            return 2;
+        }
+
+        struct Check {
+            const char* key;
+            double Metrics::* field;
+            bool higherIsBetter;
+        };
+        const Check checks[] = {
+            { "files_per_s", &Metrics::filesPerSecond, true },
+            { "mb_per_s", &Metrics::megabytesPerSecond, true },
+            { "p50_ms", &Metrics::p50Ms, false },
+            { "p99_ms", &Metrics::p99Ms, false },
+        };
+
+        int regressions = 0;
+        int compared = 0;
+        for (const auto& [modeName, rows] : results) {
+            YAML::Node types = baseline["modes"][modeName]["types"];
+            if (!types) continue;
+            for (const auto& [name, m] : rows) {
+                YAML::Node base = types[name];
+                if (!base) continue;
+
+                auto report = [&](const char* key, double was, double now, double change, double limit) {
+                    compared++;
+                    if (change * 100 > limit) {
+                        regressions++;
+                        std::cout << fmt::format("REGRESSION {}/{} {}: {:.4g} -> {:.4g} ({:+.1f}%, limit {:.0f}%)\n",
+                            modeName, name, key, was, now, change * 100, limit);
+                    }
+                };
+                for (const auto& check : checks) {
+                    double was = base[check.key] ? base[check.key].as<double>() : 0;
+                    double now = m.*check.field;
+                    if (was <= 0) continue;
+                    report(check.key, was, now, check.higherIsBetter ? (was - now) / was : (now - was) / was, threshold);
+                }
+                double wasRss = base["peak_rss_kb"] ? base["peak_rss_kb"].as<double>() : 0;
+                if (wasRss > 0) {
+                    report("peak_rss_kb", wasRss, static_cast<double>(m.peakRssKb), (m.peakRssKb - wasRss) / wasRss, rssThreshold);
+                }
+            }
+        }
+        std::cout << fmt::format("Compared {} metric(s) against {}: {} regression(s)\n", compared, baselinePath, regressions);
+        return regressions > 0 ? 1 : 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{ "ReCap end-to-end benchmark" };
+
+    std::string cliPath;
+    std::string corpusDir;
+    std::string baselinePath;
+    std::string jsonPath = "recap_bench_e2e.json";
+    std::string newBaselinePath;
+    std::string gameVersion = "5.3.0.103";
+    double threshold = 10;
+    double rssThreshold = 20;
+    int rounds = 3;
+    std::vector<std::string> allocCorpora;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+    app.add_option("--cli", cliPath, "The recap_parser binary to measure")->required();
+    app.add_option("--corpus", corpusDir, "Directory of input files, e.g. from recap_corpus_gen")->required();
+    app.add_option("--baseline", baselinePath, "Fail if a metric is worse than in this results file");
+    app.add_option("--threshold", threshold, "Allowed throughput and latency regression in percent (default 10)");
+    app.add_option("--rss-threshold", rssThreshold, "Allowed peak RSS regression in percent (default 20)");
+    app.add_option("--rounds", rounds, "CLI runs per measurement; the fastest counts (default 3)");
+    app.add_option("--jobs,-j", jobs, "Workers for the multi-thread modes (default: one per core)");
+    app.add_option("--json", jsonPath, "Where to write the results (default recap_bench_e2e.json)");
+    app.add_option("--write-baseline", newBaselinePath, "Also write the results here, as the new baseline");
+    app.add_option("--alloc-corpora", allocCorpora, "Two corpora that differ only in array and string lengths; fail if decoding the second allocates more")->expected(2);
+    app.add_option("--game-version,--gv", gameVersion);
+    CLI11_PARSE(app, argc, argv);
+    rounds = std::max(1, rounds);
+    cliPath = fs::absolute(cliPath).string();
+
+    Catalog catalog;
+    catalog.setGameVersion(gameVersion);
+
+    std::map<std::string, std::vector<CorpusFile>> byType;
+    std::vector<CorpusFile> all;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(corpusDir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file(ec) || !catalog.findFileType(it->path().string())) continue;
+        CorpusFile file{ fs::absolute(it->path()), static_cast<uint64_t>(it->file_size(ec)) };
+        byType[label(file.path)].push_back(file);
+        all.push_back(file);
+    }
+    if (all.empty()) {
+        std::cerr << "No files of a registered type under " << corpusDir << "\n";
+        return 2;
+    }
+
+    fs::path workDir = fs::temp_directory_path() / fmt::format("recap_bench_e2e_{}", getpid());
+    fs::create_directories(workDir);
+    auto writeList = [&](const std::string& name, const std::vector<CorpusFile>& files) {
+        fs::path listPath = workDir / (name + ".list");
+        std::ofstream list(listPath);
+        for (const auto& file : files) list << file.path.string() << "\n";
+        return listPath;
+    };
+    std::map<std::string, fs::path> lists;
+    lists["all"] = writeList("all", all);
+    for (const auto& [name, files] : byType) {
+        lists[name] = writeList(name, files);
+    }
+
+    std::vector<Mode> modes;
+    for (const char* format : { "none", "xml", "yaml" }) {
+        modes.push_back({ format, 1, std::string(format) + "-single" });
+        modes.push_back({ format, jobs, std::string(format) + "-multi" });
+    }
+
+    std::cout << fmt::format("{} file(s), {} type(s), {:.1f} MB; {} round(s), multi = {} thread(s)\n\n",
+        all.size(), byType.size(), std::accumulate(all.begin(), all.end(), 0.0, [](double sum, const CorpusFile& f) { return sum + f.size; }) / (1024.0 * 1024.0),
+        rounds, jobs);
+    std::cout << fmt::format("{:<12} {:<22} {:>7} {:>11} {:>9} {:>9} {:>9} {:>10}\n",
+        "mode", "type", "files", "files/s", "MB/s", "p50 ms", "p99 ms", "peak RSS");
+
+    Results results;
+    bool failedRun = false;
+    for (const auto& mode : modes) {
+        fs::path outDir = workDir / "out";
+        fs::path latencyDir = workDir / "latency";
+        fs::create_directories(latencyDir, ec);
+        // Like the CLI runs, each file keeps its fastest round.
+        std::vector<double> latencies = measureLatencies(catalog, all, mode, latencyDir);
+        for (int round = 1; round < rounds; round++) {
+            std::vector<double> again = measureLatencies(catalog, all, mode, latencyDir);
+            for (size_t i = 0; i < latencies.size(); i++) {
+                latencies[i] = std::min(latencies[i], again[i]);
+            }
+        }
+
+        auto measureRow = [&](const std::string& name, const std::vector<CorpusFile>& files, const std::vector<double>& rowLatencies) {
+            Metrics m;
+            m.files = files.size();
+            for (const auto& file : files) m.bytes += file.size;
+
+            std::vector<std::string> args = { cliPath, "--files-from", lists[name].string(), "-j", std::to_string(mode.threads),
+                "-s", "--silent", "--gv", gameVersion, "-o", outDir.string() };
+            if (mode.format != "none") args.push_back("--" + mode.format);
+
+            CliRun best;
+            for (int round = 0; round < rounds; round++) {
+                fs::remove_all(outDir, ec);
+                CliRun run = runCli(args);
+                if (!run.ok) {
+                    failedRun = true;
+                    std::cerr << "recap_parser failed in " << mode.name << " on " << name << "\n";
+                }
+                if (round == 0 || run.seconds < best.seconds) best = run;
+            }
+            m.filesPerSecond = m.files / best.seconds;
+            m.megabytesPerSecond = m.bytes / best.seconds / (1024.0 * 1024.0);
+            m.peakRssKb = best.peakRssKb;
+            m.p50Ms = percentile(rowLatencies, 0.50);
+            m.p99Ms = percentile(rowLatencies, 0.99);
+            results[mode.name][name] = m;
+            std::cout << fmt::format("{:<12} {:<22} {:>7} {:>11.0f} {:>9.1f} {:>9.3f} {:>9.3f} {:>7} KB\n",
+                mode.name, name, m.files, m.filesPerSecond, m.megabytesPerSecond, m.p50Ms, m.p99Ms, m.peakRssKb);
+        };
+
+        measureRow("all", all, latencies);
+        // Latencies of one type are picked out of the whole-corpus pass.
+        std::map<std::string, std::vector<double>> typeLatencies;
+        for (size_t i = 0; i < all.size(); i++) {
+            typeLatencies[label(all[i].path)].push_back(latencies[i]);
+        }
+        for (const auto& [name, files] : byType) {
+            measureRow(name, files, typeLatencies[name]);
+        }
+    }
+
+    int allocStatus = 0;
+    if (!allocCorpora.empty()) {
+        allocStatus = checkAllocations(decodeAllocations(cliPath, gameVersion, allocCorpora[0], workDir, "allocs_short"),
+            decodeAllocations(cliPath, gameVersion, allocCorpora[1], workDir, "allocs_long"));
+    }
+    fs::remove_all(workDir, ec);
+
+    writeJson(jsonPath, results, modes);
+    if (!newBaselinePath.empty()) {
+        writeJson(newBaselinePath, results, modes);
+    }
+    std::cout << "\nResults written to " << jsonPath << "\n";
+
+    int status = failedRun ? 2 : allocStatus;
+    if (!baselinePath.empty()) {
+        status = std::max(status, compare(baselinePath, results, threshold, rssThreshold));
+    }
+    return status;
+}
@@ -0,0 +1,111 @@
+// Compares the ways recap_parser can load a tree of small asset files:
+// std::ifstream per file, open/fstat/pread per file, and BulkReader's
+// batched io_uring submissions.
+//
+//   recap_read_bench <directory> [rounds]
+//
+// Every round reads every file once; the best round is reported. Results are
+// for a warm page cache unless caches are dropped between runs.
+
+#include "bulk_reader.h"
+#include "package.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+    bool readWithStream(const fs::path& path, std::vector<char>& out) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return false;
+        }
+        std::streamoff size = in.tellg();
+        in.seekg(0);
+        out.resize(size > 0 ? static_cast<size_t>(size) : 0);
+        return out.empty() || static_cast<bool>(in.read(out.data(), out.size()));
+    }
+
+    struct Result {
+        double seconds = 0;
+        size_t files = 0;
+        size_t bytes = 0;
+    };
+
+    Result measure(const std::vector<fs::path>& paths, int rounds,
+        const std::function<void(std::vector<LoadedFile>&)>& readAll) {
+        Result best;
+        for (int round = 0; round < rounds; round++) {
+            std::vector<LoadedFile> files(paths.size());
+            for (size_t i = 0; i < paths.size(); i++) {
+                files[i].path = paths[i];
+            }
+
+            auto started = std::chrono::steady_clock::now();
+            readAll(files);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+            Result result{ elapsed.count(), 0, 0 };
+            for (const auto& file : files) {
+                if (file.loaded) {
+                    result.files++;
+                    result.bytes += file.data.size();
+                }
+            }
+            if (round == 0 || result.seconds < best.seconds) {
+                best = result;
+            }
+        }
+        return best;
+    }
+
+    void report(const char* name, const Result& result, size_t expected) {
+        std::printf("%-8s %9.3f ms %12.0f files/s %9.1f MB/s%s\n", name, result.seconds * 1e3,
+            result.files / result.seconds, result.bytes / result.seconds / (1024.0 * 1024.0),
+            result.files == expected ? "" : "  (some files failed)");
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <directory> [rounds]\n", argv[0]);
+        return 1;
+    }
+    int rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    std::vector<fs::path> paths;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(argv[1], ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec)) {
+            paths.push_back(it->path());
+        }
+    }
+    if (paths.empty()) {
+        std::fprintf(stderr, "no files under %s\n", argv[1]);
+        return 1;
+    }
+    std::printf("%zu files, best of %d rounds\n", paths.size(), rounds);
+
+    report("ifstream", measure(paths, rounds, [](std::vector<LoadedFile>& files) {
+        for (auto& file : files) file.loaded = readWithStream(file.path, file.data);
+    }), paths.size());
+
+    report("pread", measure(paths, rounds, [](std::vector<LoadedFile>& files) {
+        for (auto& file : files) file.loaded = readWholeFile(file.path.string(), file.data);
+    }), paths.size());
+
+    if (BulkReader::uringAvailable()) {
+        BulkReader reader(ReadBackend::Uring);
+        report("io_uring", measure(paths, rounds, [&](std::vector<LoadedFile>& files) {
+            reader.read(files);
+        }), paths.size());
+    }
+    else {
+        std::printf("io_uring unavailable\n");
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Microbenchmarks for the hot paths of a conversion: OffsetManager reads,
+// struct decoding per file type, and the per-field cost of each exporter.
+//
+//   recap_bench [--benchmark_filter=<regex>] [google benchmark flags]
+//
+// Results are also written to recap_bench.json (Google Benchmark's JSON
+// format) unless --benchmark_out is given, so runs on two commits can be
+// compared with benchmark's tools/compare.py.
+//
+// Struct decoding uses real assets when RECAP_BENCH_CORPUS names a directory
+// (the first file of each type found in it); otherwise a zero-filled buffer,
+// which decodes every member with empty strings and arrays.
+
+#include <benchmark/benchmark.h>
+
+#include "catalog.h"
+#include "exporter.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+    const std::string GAME_VERSION = "5.3.0.103";
+    constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    Catalog& sharedCatalog() {
+        static Catalog catalog;
+        static bool configured = (catalog.setGameVersion(GAME_VERSION), true);
+        (void)configured;
+        return catalog;
+    }
+
+    template<typename T>
+    void BM_ReadPrimary(benchmark::State& state) {
+        std::vector<char> buffer(BUFFER_SIZE, 1);
+        OffsetManager offsets;
+        offsets.attach(buffer.data(), buffer.size());
+        const size_t last = buffer.size() - sizeof(T);
+        for (auto _ : state) {
+            if (offsets.getPrimaryOffset() > last) {
+                offsets.setPrimaryOffset(0);
+            }
+            benchmark::DoNotOptimize(offsets.readPrimary<T>());
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * sizeof(T));
+    }
+    BENCHMARK_TEMPLATE(BM_ReadPrimary, uint8_t);
+    BENCHMARK_TEMPLATE(BM_ReadPrimary, uint32_t);
+    BENCHMARK_TEMPLATE(BM_ReadPrimary, uint64_t);
+    BENCHMARK_TEMPLATE(BM_ReadPrimary, float);
+
+    // Back-to-back NUL-terminated strings of state.range(0) characters.
+    std::vector<char> stringBuffer(size_t length) {
+        std::vector<char> buffer;
+        while (buffer.size() + length + 1 <= BUFFER_SIZE) {
+            buffer.insert(buffer.end(), length, 'a');
+            buffer.push_back('\0');
+        }
+        return buffer;
+    }
+
+    void BM_ReadString(benchmark::State& state) {
+        const size_t length = static_cast<size_t>(state.range(0));
+        std::vector<char> buffer = stringBuffer(length);
+        OffsetManager offsets;
+        offsets.attach(buffer.data(), buffer.size());
+        for (auto _ : state) {
+            if (offsets.getSecondaryOffset() >= buffer.size()) {
+                offsets.setSecondaryOffset(0);
+            }
+            benchmark::DoNotOptimize(offsets.readString(true));
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * (length + 1));
+    }
+    BENCHMARK(BM_ReadString)->Arg(0)->Arg(8)->Arg(32)->Arg(256);
+
+    void BM_SkipString(benchmark::State& state) {
+        const size_t length = static_cast<size_t>(state.range(0));
+        std::vector<char> buffer = stringBuffer(length);
+        OffsetManager offsets;
+        offsets.attach(buffer.data(), buffer.size());
+        for (auto _ : state) {
+            if (offsets.getSecondaryOffset() >= buffer.size()) {
+                offsets.setSecondaryOffset(0);
+            }
+            offsets.skipString(true);
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * (length + 1));
+    }
+    BENCHMARK(BM_SkipString)->Arg(0)->Arg(8)->Arg(32)->Arg(256);
+
+    // One file type: decode only, or decode and build the document.
+    void BM_ParseFileType(benchmark::State& state, std::string filename, std::vector<char> input, std::string format) {
+        const Catalog& catalog = sharedCatalog();
+        std::string document;
+        for (auto _ : state) {
+            Parser parser(catalog, filename, true, false, format);
+            if (!parser.parse(input.data(), input.size())) {
+                state.SkipWithError("parse failed");
+                break;
+            }
+            if (format != "none") {
+                parser.exportToString(document);
+                benchmark::DoNotOptimize(document.data());
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // First file of each type under RECAP_BENCH_CORPUS, keyed by extension.
+    std::map<std::string, std::string> corpusSamples() {
+        std::map<std::string, std::string> samples;
+        const char* corpus = std::getenv("RECAP_BENCH_CORPUS");
+        if (!corpus) {
+            return samples;
+        }
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(corpus, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file(ec)) {
+                samples.emplace(it->path().extension().string(), it->path().string());
+            }
+        }
+        return samples;
+    }
+
+    void registerFileTypes() {
+        std::map<std::string, std::string> samples = corpusSamples();
+        for (const auto& ext : sharedCatalog().getRegisteredExtensions()) {
+            std::string dotted = ext[0] == '.' ? ext : "." + ext;
+            std::vector<char> input(BUFFER_SIZE, 0);
+            auto sample = samples.find(dotted);
+            if (sample != samples.end()) {
+                std::ifstream in(sample->second, std::ios::binary);
+                input.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+            std::string filename = "bench" + dotted;
+            for (const char* format : { "none", "xml", "yaml" }) {
+                benchmark::RegisterBenchmark(("BM_ParseFileType/" + dotted.substr(1) + "/" + format).c_str(),
+                    BM_ParseFileType, filename, input, std::string(format));
+            }
+        }
+    }
+
+    // Per-field cost: FIELDS fields of one kind into a fresh document, then
+    // serialised, so the item rate is fields per second including the save.
+    constexpr int FIELDS = 1024;
+
+    enum class FieldKind { UInt32, Float, String, Vector3, Nested };
+
+    void BM_Export(benchmark::State& state, std::string format, FieldKind kind) {
+        const std::string name = "field";
+        const std::string text = "an asset name";
+        std::string document;
+        for (auto _ : state) {
+            std::unique_ptr<FormatExporter> exporter = ExporterFactory::createExporter(format);
+            exporter->beginDocument();
+            exporter->beginNode("root");
+            for (int i = 0; i < FIELDS; i++) {
+                switch (kind) {
+                case FieldKind::UInt32: exporter->exportUInt32(name, static_cast<uint32_t>(i)); break;
+                case FieldKind::Float: exporter->exportFloat(name, i * 0.5f); break;
+                case FieldKind::String: exporter->exportString(name, text); break;
+                case FieldKind::Vector3: exporter->exportVector3(name, 1.0f, 2.0f, 3.0f); break;
+                case FieldKind::Nested:
+                    exporter->beginNode(name);
+                    exporter->exportUInt32("value", static_cast<uint32_t>(i));
+                    exporter->endNode();
+                    break;
+                }
+            }
+            exporter->endNode();
+            exporter->endDocument();
+            exporter->saveToString(document);
+            benchmark::DoNotOptimize(document.data());
+        }
+        state.SetItemsProcessed(state.iterations() * FIELDS);
+    }
+
+    void registerExporters() {
+        const std::pair<const char*, FieldKind> kinds[] = {
+            { "uint32", FieldKind::UInt32 },
+            { "float", FieldKind::Float },
+            { "string", FieldKind::String },
+            { "vector3", FieldKind::Vector3 },
+            { "nested", FieldKind::Nested },
+        };
+        for (const char* format : { "xml", "yaml" }) {
+            for (const auto& kind : kinds) {
+                benchmark::RegisterBenchmark((std::string("BM_Export/") + format + "/" + kind.first).c_str(),
+                    BM_Export, std::string(format), kind.second);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++) {
+        hasOut = hasOut || std::strncmp(argv[i], "--benchmark_out=", 16) == 0;
+    }
+    std::string outArg = "--benchmark_out=recap_bench.json";
+    std::string formatArg = "--benchmark_out_format=json";
+    if (!hasOut) {
+        args.push_back(outArg.data());
+        args.push_back(formatArg.data());
+    }
+    int count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+        return 1;
+    }
+    registerFileTypes();
+    registerExporters();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
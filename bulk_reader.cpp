@@ -0,0 +1,346 @@
+#include "bulk_reader.h"
+#include "package.h"
+#include <unordered_map>
+#include <algorithm>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define RECAP_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef RECAP_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+#ifdef RECAP_HAVE_IO_URING
+
+namespace {
+    int uringSetup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+}
+
+// The kernel-shared submission and completion rings, mapped by hand so that
+// no liburing is needed.
+struct BulkReader::Ring {
+    static constexpr unsigned DEPTH = 256;
+
+    int fd = -1;
+    void* sqMap = nullptr;
+    size_t sqMapSize = 0;
+    void* cqMap = nullptr;
+    size_t cqMapSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned capacity = 0;
+    unsigned queued = 0;
+
+    bool open() {
+        io_uring_params params{};
+        fd = uringSetup(DEPTH, &params);
+        if (fd < 0) {
+            return false;
+        }
+        capacity = params.sq_entries;
+
+        sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+        }
+
+        sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) {
+            sqMap = nullptr;
+            return false;
+        }
+        if (singleMap) {
+            cqMap = sqMap;
+        }
+        else {
+            cqMap = mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqMap == MAP_FAILED) {
+                cqMap = nullptr;
+                return false;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqeMap == MAP_FAILED) {
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+        char* sq = static_cast<char*>(sqMap);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqMap);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqMap && cqMap != sqMap) munmap(cqMap, cqMapSize);
+        if (sqMap) munmap(sqMap, sqMapSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    io_uring_sqe* next(uint64_t userData) {
+        unsigned tail = *sqTail + queued;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = userData;
+        sqArray[index] = index;
+        queued++;
+        return sqe;
+    }
+
+    // Submits everything queued and calls onComplete for each completion.
+    // False if the ring failed; the caller then falls back for the batch.
+    // Even then, every request the kernel took has completed on return, so
+    // the buffers they point into can be released.
+    template<typename Callback>
+    bool run(Callback onComplete) {
+        unsigned count = queued;
+        __atomic_store_n(sqTail, *sqTail + queued, __ATOMIC_RELEASE);
+        queued = 0;
+
+        unsigned submitted = 0;
+        unsigned completed = 0;
+        auto reap = [&]() {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, completed++) {
+                const io_uring_cqe& cqe = cqes[head & *cqMask];
+                onComplete(cqe.user_data, cqe.res);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        };
+        while (completed < count) {
+            unsigned toSubmit = count - submitted;
+            int result = uringEnter(fd, toSubmit, 1, IORING_ENTER_GETEVENTS);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                // Submit nothing more, but wait out what is in flight.
+                while (completed < submitted) {
+                    if (uringEnter(fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                        // The ring cannot even be waited on; the requests
+                        // may still write, so nothing may be freed.
+                        std::abort();
+                    }
+                    reap();
+                }
+                return false;
+            }
+            submitted += static_cast<unsigned>(result);
+            reap();
+        }
+        return true;
+    }
+};
+
+namespace {
+    struct PendingFile {
+        int fd = -1;
+        struct statx info;
+        int statResult = 0;
+    };
+
+    // One IORING_OP_READ takes a 32-bit length and returns an int, and the
+    // kernel stops a single read short of 2 GiB; larger files go to pread.
+    constexpr uint64_t MAX_URING_READ = uint64_t(1) << 30;
+}
+
+void BulkReader::readWithUring(std::vector<LoadedFile*>& files) {
+    // Two submissions per file in the first round: openat and statx.
+    const size_t batchSize = ring->capacity / 2;
+    std::vector<PendingFile> pending;
+    std::unordered_map<std::string, int> dirs;
+    bool broken = false;
+
+    for (size_t first = 0; first < files.size(); first += batchSize) {
+        size_t count = std::min(batchSize, files.size() - first);
+        pending.assign(count, PendingFile{});
+
+        for (size_t i = 0; i < count; i++) {
+            LoadedFile& file = *files[first + i];
+            std::string parent = file.path.parent_path().string();
+            auto dir = dirs.find(parent);
+            if (dir == dirs.end()) {
+                int dirFd = ::open(parent.empty() ? "." : parent.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+                dir = dirs.emplace(parent, dirFd).first;
+            }
+            // Names point into path, which outlives the batch.
+            int dirFd = dir->second;
+            const char* relative = file.path.c_str();
+            if (dirFd >= 0) {
+                relative += file.path.native().size() - file.path.filename().native().size();
+            }
+            else {
+                dirFd = AT_FDCWD;
+            }
+
+            io_uring_sqe* open = ring->next(i * 2);
+            open->opcode = IORING_OP_OPENAT;
+            open->fd = dirFd;
+            open->addr = reinterpret_cast<uint64_t>(relative);
+            open->open_flags = O_RDONLY | O_CLOEXEC;
+
+            io_uring_sqe* stat = ring->next(i * 2 + 1);
+            stat->opcode = IORING_OP_STATX;
+            stat->fd = dirFd;
+            stat->addr = reinterpret_cast<uint64_t>(relative);
+            stat->len = STATX_SIZE;
+            stat->off = reinterpret_cast<uint64_t>(&pending[i].info);
+        }
+        bool ok = ring->run([&](uint64_t userData, int result) {
+            PendingFile& file = pending[userData / 2];
+            if (userData % 2 == 0) {
+                file.fd = result;
+            }
+            else {
+                file.statResult = result;
+            }
+        });
+        if (!ok) {
+            broken = true;
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            LoadedFile& file = *files[first + i];
+            if (pending[i].fd < 0 || pending[i].statResult < 0 || pending[i].info.stx_size > MAX_URING_READ) {
+                continue;
+            }
+            file.data.resize(static_cast<size_t>(pending[i].info.stx_size));
+            if (file.data.empty()) {
+                file.loaded = true;
+                continue;
+            }
+            io_uring_sqe* read = ring->next(i);
+            read->opcode = IORING_OP_READ;
+            read->fd = pending[i].fd;
+            read->addr = reinterpret_cast<uint64_t>(file.data.data());
+            read->len = static_cast<uint32_t>(file.data.size());
+            read->off = 0;
+        }
+        ok = ring->run([&](uint64_t userData, int result) {
+            LoadedFile& file = *files[first + userData];
+            // A short read (file still growing or shrinking) is redone below.
+            file.loaded = result >= 0 && static_cast<size_t>(result) == file.data.size();
+        });
+
+        for (size_t i = 0; i < count; i++) {
+            if (pending[i].fd >= 0) {
+                io_uring_sqe* close = ring->next(i);
+                close->opcode = IORING_OP_CLOSE;
+                close->fd = pending[i].fd;
+            }
+        }
+        // Closed by the ring, or at least no longer to be closed by hand.
+        if (!ok || !ring->run([&](uint64_t userData, int) { pending[userData].fd = -1; })) {
+            broken = true;
+            break;
+        }
+    }
+
+    // The ring stopped working partway: close by hand what it opened and
+    // leave the rest of this reader's life to pread.
+    if (broken) {
+        for (auto& file : pending) {
+            if (file.fd >= 0) ::close(file.fd);
+        }
+        ring.reset();
+    }
+
+    for (auto& dir : dirs) {
+        if (dir.second >= 0) ::close(dir.second);
+    }
+}
+
+#else
+
+struct BulkReader::Ring {
+};
+
+void BulkReader::readWithUring(std::vector<LoadedFile*>&) {
+}
+
+#endif
+
+BulkReader::BulkReader(ReadBackend backend) {
+#ifdef RECAP_HAVE_IO_URING
+    if (backend != ReadBackend::Pread) {
+        ring = std::make_unique<Ring>();
+        if (!ring->open()) {
+            ring.reset();
+        }
+    }
+#else
+    (void)backend;
+#endif
+}
+
+BulkReader::~BulkReader() = default;
+
+bool BulkReader::uringAvailable() {
+#ifdef RECAP_HAVE_IO_URING
+    Ring probe;
+    return probe.open();
+#else
+    return false;
+#endif
+}
+
+bool BulkReader::usingUring() const {
+    return ring != nullptr;
+}
+
+void BulkReader::read(std::vector<LoadedFile*>& files) {
+    if (ring) {
+        readWithUring(files);
+    }
+    // Whatever the ring could not read, including every file without one.
+    for (LoadedFile* file : files) {
+        if (!file->loaded) {
+            file->loaded = readWholeFile(file->path.string(), file->data);
+        }
+    }
+}
+
+void BulkReader::read(std::vector<LoadedFile>& files) {
+    std::vector<LoadedFile*> pointers;
+    pointers.reserve(files.size());
+    for (auto& file : files) {
+        pointers.push_back(&file);
+    }
+    read(pointers);
+}
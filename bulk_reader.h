@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+// A whole file read into memory; loaded is false if it could not be read.
+struct LoadedFile {
+    fs::path path;
+    std::vector<char> data{};
+    bool loaded = false;
+};
+
+enum class ReadBackend { Auto, Uring, Pread };
+
+// Reads many small files with as few system calls as possible. On Linux with
+// io_uring, each batch is a handful of io_uring_enter calls: one for all the
+// openat and statx requests, relative to an fd of each parent directory, one
+// for the reads, and one for the closes. Where io_uring is missing or refused
+// (old kernels, seccomp), every file is read with pread instead.
+//
+// A reader owns its ring, so use one per thread.
+class BulkReader {
+private:
+    struct Ring;
+    std::unique_ptr<Ring> ring;
+
+    void readWithUring(std::vector<LoadedFile*>& files);
+
+public:
+    explicit BulkReader(ReadBackend backend = ReadBackend::Auto);
+    BulkReader(const BulkReader&) = delete;
+    BulkReader& operator=(const BulkReader&) = delete;
+    ~BulkReader();
+
+    // Whether this build and the running kernel can set up a ring.
+    static bool uringAvailable();
+    bool usingUring() const;
+
+    void read(std::vector<LoadedFile*>& files);
+    void read(std::vector<LoadedFile>& files);
+};
@@ -1,4 +1,6 @@
 ﻿#include "catalog.h"
+#include "hash.h"
+#include <unordered_set>
 
 Catalog::Catalog() {
     initialize();
@@ -1548,4 +1550,68 @@ void Catalog::initialize() {
     //   PVPLevels
     auto PVPLevels = add_struct("PVPLevels");
          PVPLevels->addArray("levels", "asset", 0); //unk data name
-}
\ No newline at end of file
+}
+
+uint64_t Catalog::getSchemaHash(const FileTypeInfo* fileTypeInfo) const {
+    if (!fileTypeInfo) {
+        return 0;
+    }
+
+    const VersionedFileTypeInfo* versionedInfo = getVersionedFileTypeInfo(fileTypeInfo);
+    const std::vector<std::string>& structTypes = versionedInfo ? versionedInfo->structTypes : fileTypeInfo->structTypes;
+    size_t secondaryOffsetStart = versionedInfo ? versionedInfo->secondaryOffsetStart : fileTypeInfo->secondaryOffsetStart;
+
+    std::string schema = std::to_string(secondaryOffsetStart);
+    auto append = [&schema](const std::string& field) {
+        schema += '\0';
+        schema += field;
+    };
+    auto appendType = [&](const std::string& typeName) {
+        append(typeName);
+        if (const TypeDefinition* typeDef = getType(typeName)) {
+            append(std::to_string(static_cast<int>(typeDef->type)));
+            append(std::to_string(typeDef->size));
+            append(typeDef->targetType);
+        }
+    };
+
+    std::vector<std::string> pending(structTypes.rbegin(), structTypes.rend());
+    std::unordered_set<std::string> visited;
+    while (!pending.empty()) {
+        std::string structName = pending.back();
+        pending.pop_back();
+        append(structName);
+        if (!visited.insert(structName).second) {
+            continue;
+        }
+
+        auto structDef = getStruct(structName);
+        if (!structDef) {
+            continue;
+        }
+        append(std::to_string(structDef->getFixedSize()));
+
+        const auto& members = structDef->getMembers();
+        for (const auto& member : members) {
+            append(member.name);
+            appendType(member.typeName);
+            appendType(member.elementType);
+            append(std::to_string(member.offset));
+            append(std::to_string(member.countOffset));
+            append(member.useSecondaryOffset ? "s" : "p");
+            append(member.hasCustomName ? "n" : "-");
+        }
+
+        for (auto it = members.rbegin(); it != members.rend(); ++it) {
+            const TypeDefinition* typeDef = getType(it->typeName);
+            if (typeDef && (typeDef->type == DataType::STRUCT || typeDef->type == DataType::NULLABLE)) {
+                pending.push_back(typeDef->targetType);
+            }
+            else if (getStruct(it->elementType)) {
+                pending.push_back(it->elementType);
+            }
+        }
+    }
+
+    return xxh64(schema);
+}
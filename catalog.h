@@ -1,6 +1,8 @@
 ﻿#pragma once
 
 #include "exporter.h"
+#include "parse_trace.h"
+#include "schema_profile.h"
 #include <string>
 #include <stack>
 #include <vector>
@@ -9,6 +11,10 @@
 #include <unordered_map>
 #include <functional>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 
 #ifndef _SILENCE_STDEXT_ARR_ITERS_DEPRECATION_WARNING
 #define _SILENCE_STDEXT_ARR_ITERS_DEPRECATION_WARNING
@@ -34,6 +40,11 @@ namespace fs = std::experimental::filesystem;
 #include <fmt/core.h>
 #include <fmt/format.h>
 
+// Set to 0 to compile parse tracing out of Parser entirely.
+#ifndef RECAP_PARSE_TRACE
+#define RECAP_PARSE_TRACE 1
+#endif
+
 enum class DataType {
     BOOL,
     INT,
@@ -75,15 +86,83 @@ struct TypeDefinition {
     }
 };
 
+// Pulls the next chunk of an input stream into dst and returns the number of
+// bytes written; 0 signals the end of the input.
+using ChunkReader = std::function<size_t(char* dst, size_t capacity)>;
+
 class OffsetManager {
 private:
     size_t primaryOffset = 0;
     size_t secondaryOffset = 0;
-    std::ifstream& fileStream;
     size_t displaySecondaryOffset = 0;
 
+    const char* data = nullptr;
+    size_t dataSize = 0;
+    std::vector<char> storage;
+    ChunkReader reader;
+
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    // Offsets jump back into the primary block and forward into the secondary
+    // region, so everything pulled so far stays buffered until the parse ends.
+    // The buffer grows a chunk at a time, so a corrupt count or offset far
+    // past the end of a short stream costs one failed read, not a huge buffer.
+    bool fetch(size_t end) {
+        while (reader && dataSize < end) {
+            if (storage.size() < dataSize + CHUNK_SIZE) {
+                storage.resize(dataSize + CHUNK_SIZE);
+            }
+            size_t received = reader(storage.data() + dataSize, CHUNK_SIZE);
+            if (received == 0) {
+                reader = nullptr;
+            }
+            dataSize += received;
+            data = storage.data();
+        }
+        return dataSize >= end;
+    }
+
 public:
-    OffsetManager(std::ifstream& fs) : fileStream(fs) {}
+    OffsetManager() = default;
+
+    bool load(const std::string& filename) {
+        std::ifstream fileStream(filename, std::ios::binary | std::ios::ate);
+        if (!fileStream) {
+            return false;
+        }
+        std::streamoff fileSize = fileStream.tellg();
+        fileStream.seekg(0);
+        storage.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+        if (!storage.empty() && !fileStream.read(storage.data(), storage.size())) {
+            return false;
+        }
+        reader = nullptr;
+        data = storage.data();
+        dataSize = storage.size();
+        return true;
+    }
+
+    // The caller keeps the buffer alive for the duration of the parse.
+    void attach(const char* bytes, size_t length) {
+        storage.clear();
+        reader = nullptr;
+        data = bytes;
+        dataSize = length;
+    }
+
+    void attach(ChunkReader chunkReader) {
+        storage.clear();
+        reader = std::move(chunkReader);
+        data = nullptr;
+        dataSize = 0;
+    }
+
+    void detach() {
+        std::vector<char>().swap(storage);
+        reader = nullptr;
+        data = nullptr;
+        dataSize = 0;
+    }
 
     void setPrimaryOffset(size_t offset) {
         primaryOffset = offset;
@@ -109,6 +188,11 @@ public:
         return secondaryOffset;
     }
 
+    // Bytes available so far; for a chunked reader, what has been pulled.
+    size_t getLoadedSize() const {
+        return dataSize;
+    }
+
     void advancePrimary(size_t bytes) {
         primaryOffset += bytes;
     }
@@ -118,9 +202,7 @@ public:
     }
 
     bool isValidOffset(size_t offset, size_t size) {
-        fileStream.seekg(0, std::ios::end);
-        size_t fileSize = fileStream.tellg();
-        return (offset + size <= fileSize);
+        return (offset + size <= dataSize) || fetch(offset + size);
     }
 
     template<typename T>
@@ -131,17 +213,20 @@ public:
         }
 
         T value;
-        fileStream.seekg(primaryOffset);
-        fileStream.read(reinterpret_cast<char*>(&value), sizeof(T));
+        std::memcpy(&value, data + primaryOffset, sizeof(T));
         primaryOffset += sizeof(T);
         return value;
     }
 
     template<typename T>
     T readSecondary() {
+        if (!isValidOffset(secondaryOffset, sizeof(T))) {
+            throw std::runtime_error("Attempted to read beyond end of file at offset " +
+                std::to_string(secondaryOffset));
+        }
+
         T value;
-        fileStream.seekg(secondaryOffset);
-        fileStream.read(reinterpret_cast<char*>(&value), sizeof(T));
+        std::memcpy(&value, data + secondaryOffset, sizeof(T));
         secondaryOffset += sizeof(T);
         return value;
     }
@@ -153,25 +238,37 @@ public:
                 std::to_string(offset));
         }
 
-        std::streampos currentPos = fileStream.tellg();
-
-        fileStream.seekg(offset);
         T value;
-        fileStream.read(reinterpret_cast<char*>(&value), sizeof(T));
-
-        fileStream.seekg(currentPos);
-
+        std::memcpy(&value, data + offset, sizeof(T));
         return value;
     }
 
+    // Returns the terminating NUL of the string at offset, pulling more input as
+    // needed, or nullptr if the input ends first.
+    const char* findTerminator(size_t offset) {
+        size_t scanned = offset;
+        while (true) {
+            if (scanned < dataSize) {
+                const char* terminator = static_cast<const char*>(std::memchr(data + scanned, '\0', dataSize - scanned));
+                if (terminator) {
+                    return terminator;
+                }
+                scanned = dataSize;
+            }
+            if (!fetch(dataSize + 1)) {
+                return nullptr;
+            }
+        }
+    }
+
     std::string readString(bool useSecondary = false) {
         size_t currentOffset = useSecondary ? secondaryOffset : primaryOffset;
-        fileStream.seekg(currentOffset);
+        const char* terminator = findTerminator(currentOffset);
 
         std::string result;
-        char c;
-        while (fileStream.get(c) && c != '\0') {
-            result += c;
+        if (currentOffset < dataSize) {
+            const char* end = terminator ? terminator : data + dataSize;
+            result.assign(data + currentOffset, end);
         }
 
         size_t newOffset = currentOffset + result.length() + 1;
@@ -184,6 +281,25 @@ public:
 
         return result;
     }
+
+    // Advances past a string exactly like readString, without copying it.
+    void skipString(bool useSecondary = false) {
+        size_t currentOffset = useSecondary ? secondaryOffset : primaryOffset;
+        const char* terminator = findTerminator(currentOffset);
+
+        size_t length = 0;
+        if (currentOffset < dataSize) {
+            length = (terminator ? terminator : data + dataSize) - (data + currentOffset);
+        }
+
+        size_t newOffset = currentOffset + length + 1;
+        if (useSecondary) {
+            secondaryOffset = newOffset;
+        }
+        else {
+            primaryOffset = newOffset;
+        }
+    }
 };
 
 struct StructMember {
@@ -384,6 +500,33 @@ public:
         return result;
     }
 
+    std::vector<std::string> getStructNames() const {
+        std::vector<std::string> result;
+        for (const auto& pair : structs) {
+            result.push_back(pair.first);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Lowercase extensions (with leading dot) of every registered file type.
+    std::vector<std::string> getRegisteredExtensions() const {
+        std::vector<std::string> result;
+        for (const auto& pair : fileTypes) {
+            result.push_back(pair.first);
+        }
+        return result;
+    }
+
+    // Lowercase names registered with registerFileName.
+    std::vector<std::string> getRegisteredFileNames() const {
+        std::vector<std::string> result;
+        for (const auto& pair : exactFileNames) {
+            result.push_back(pair.first);
+        }
+        return result;
+    }
+
     void registerFileType(const std::string& extension, const std::vector<std::string>& structTypes, size_t secondaryOffsetStart = 0) {
         std::string ext = extension;
         for (auto& c : ext) {
@@ -475,6 +618,20 @@ public:
         return nullptr;
     }
 
+    // Extension first, then exact file names such as catalog_131.
+    const FileTypeInfo* findFileType(const std::string& filename) const {
+        const FileTypeInfo* fileType = getFileType(fs::path(filename).extension().string());
+        if (!fileType) {
+            fileType = getFileTypeByName(filename);
+        }
+        return fileType;
+    }
+
+    // Hash of everything that shapes the decoding of a file type under the
+    // current game version: its root structs and every struct and type they
+    // reach. Editing an unrelated struct leaves it unchanged.
+    uint64_t getSchemaHash(const FileTypeInfo* fileTypeInfo) const;
+
     const VersionedFileTypeInfo* getVersionedFileTypeInfo(const FileTypeInfo* fileTypeInfo) const {
         if (!fileTypeInfo || fileTypeInfo->versionedInfo.empty()) {
             return nullptr;
@@ -492,11 +649,14 @@ public:
     void initialize();
 };
 
+class Projection;
+struct ProjectionNode;
+class Timeline;
+
 class Parser {
 private:
     const Catalog& catalog;
     OffsetManager offsetManager;
-    std::ifstream fileStream;
     std::string filename;
 
     size_t totalArraySize = 0;
@@ -520,31 +680,84 @@ private:
 
     std::unique_ptr<FormatExporter> exporter;
 
-    std::string getIndent() const {
-        return std::string(indentLevel * 4, ' ');
+    ParseTraceLog* traceLog = nullptr;
+    std::unique_ptr<ParseTraceBuffer> traceBuffer;
+
+    // --trace: long struct decodes become spans on the run's timeline.
+    Timeline* timeline = nullptr;
+
+    // --profile-schema: where the walk is in the schema, and the string
+    // bytes read so far for its byte counts.
+    SchemaProfile::Cursor profileCursor;
+    size_t stringBytes = 0;
+
+    // --select: members outside the selection are walked in pruned mode,
+    // which keeps the offsets moving but exports nothing.
+    const Projection* projection = nullptr;
+    std::vector<const ProjectionNode*> selectedNodes;
+    bool pruned = false;
+
+    // Reported by --stats.
+    size_t inputBytes = 0;
+    size_t fieldsDecoded = 0;
+    size_t stringsRead = 0;
+
+    bool exporting() const {
+        return exportMode && exporter && !pruned;
+    }
+
+    // Text that is neither exported nor traced is skipped, not copied.
+    std::string readSecondaryString() {
+        stringsRead++;
+        size_t start = offsetManager.getRealSecondaryOffset();
+        std::string value;
+        if (!exporting() && !traceEnabled()) {
+            offsetManager.skipString(true);
+        }
+        else {
+            value = offsetManager.readString(true);
+        }
+        stringBytes += offsetManager.getRealSecondaryOffset() - start;
+        return value;
     }
 
-    void logParse(const std::string& message) {
-        if (silentMode) {
+    bool traceEnabled() const {
+        return RECAP_PARSE_TRACE && (!silentMode || traceBuffer);
+    }
+
+    // Values travel as raw bits in a fixed-size record; text is only rendered
+    // when printing live, the binary log stores the record as-is.
+    void logParse(TraceOp op, std::string_view name, uint64_t value0 = 0, uint64_t value1 = 0,
+        std::string_view text0 = {}, std::string_view text1 = {}) {
+        if (!traceEnabled()) {
             return;
         }
-        if (debugMode) {
-            fmt::print("({}, {}) {}{}\n",
-                offsetManager.getPrimaryOffset(),
-                offsetManager.getSecondaryOffset(),
-                getIndent(),
-                message);
+
+        TraceRecord record{};
+        record.primaryOffset = static_cast<uint32_t>(offsetManager.getPrimaryOffset());
+        record.secondaryOffset = static_cast<uint32_t>(offsetManager.getSecondaryOffset());
+        record.op = static_cast<uint8_t>(op);
+        record.depth = static_cast<uint16_t>(indentLevel);
+        record.value[0] = value0;
+        record.value[1] = value1;
+
+        if (!silentMode) {
+            fmt::memory_buffer buffer;
+            renderTraceRecord(buffer, record, name, text0, text1, debugMode);
+            std::fwrite(buffer.data(), 1, buffer.size(), stdout);
         }
-        else {
-            fmt::print("{}{}\n", getIndent(), message);
+        if (traceBuffer) {
+            traceBuffer->append(record, name, text0, text1);
         }
     }
 
+    const FileTypeInfo* resolveFileType() const;
+    bool parseInput(const FileTypeInfo* fileType);
     void parseStruct(const std::string& structName, int arrayIndex = -1);
     void parseMember(const StructMember& member, const std::shared_ptr<StructDefinition>& parentStruct, size_t arraySize = 0);
 public:
     Parser(const Catalog& catalog, const std::string& filename, bool silentMode = true, bool debugMode = false, const std::string& exportFormat = "xml")
-        : catalog(catalog), offsetManager(fileStream), filename(filename),
+        : catalog(catalog), filename(filename),
         silentMode(silentMode), debugMode(debugMode), exportMode(exportFormat != "none") {
 
         if (exportFormat != "none") {
@@ -552,6 +765,38 @@ public:
         }
     }
 
+    void setTraceLog(ParseTraceLog* log) {
+        traceLog = log;
+    }
+
+    // Replaces the format exporter, e.g. to collect values instead of writing a file.
+    void setExporter(std::unique_ptr<FormatExporter> custom) {
+        exporter = std::move(custom);
+        exportMode = exporter != nullptr;
+    }
+
+    void setProjection(const Projection* selection) {
+        projection = selection;
+    }
+
+    void setTimeline(Timeline* runTimeline) {
+        timeline = runTimeline;
+    }
+
+    void setSchemaProfile(SchemaProfile* profile) {
+        profileCursor.attach(profile);
+    }
+
+    // Reads the whole file named at construction.
     bool parse();
-    void exportToFile(const std::string& outputFile);
+    // Parses bytes that are already in memory; filename only selects the file type.
+    bool parse(const char* data, size_t size);
+    // Pulls the input on demand, e.g. straight from an extraction stream.
+    bool parse(ChunkReader reader);
+    bool exportToFile(const std::string& outputFile);
+    bool exportToString(std::string& output);
+
+    size_t getInputBytes() const { return inputBytes; }
+    size_t getFieldsDecoded() const { return fieldsDecoded; }
+    size_t getStringsRead() const { return stringsRead; }
 };
\ No newline at end of file
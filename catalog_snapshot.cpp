@@ -0,0 +1,184 @@
+#include "catalog_snapshot.h"
+#include "exporter.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <system_error>
+
+namespace {
+    constexpr const char* SNAPSHOT_HEADER = "recap_parser catalog 3";
+
+    // Keeps the CatalogEntry fields of catalog_131 instead of building a document.
+    class CatalogCaptureExporter : public FormatExporter {
+    private:
+        std::unordered_map<std::string, CatalogRecord>& records;
+        std::vector<std::string> arrays;
+        std::string assetName;
+        CatalogRecord current;
+
+        bool inEntry() const {
+            return !arrays.empty() && arrays.back() == "entries";
+        }
+
+    public:
+        explicit CatalogCaptureExporter(std::unordered_map<std::string, CatalogRecord>& records)
+            : records(records) {
+        }
+
+        void beginDocument() override {}
+        void endDocument() override {}
+        void beginNode(const std::string&) override {}
+        void endNode() override {}
+
+        void exportBool(const std::string&, bool) override {}
+        void exportInt(const std::string&, int) override {}
+        void exportUInt8(const std::string&, uint8_t) override {}
+        void exportUInt16(const std::string&, uint16_t) override {}
+        void exportUInt64(const std::string&, uint64_t) override {}
+        void exportFloat(const std::string&, float) override {}
+        void exportGuid(const std::string&, const std::string&) override {}
+        void exportVector2(const std::string&, float, float) override {}
+        void exportVector3(const std::string&, float, float, float) override {}
+        void exportQuaternion(const std::string&, float, float, float, float) override {}
+
+        void exportUInt32(const std::string& name, uint32_t value) override {
+            if (!inEntry()) return;
+            if (name == "dataCrc") current.dataCrc = value;
+            else if (name == "typeCrc") current.typeCrc = value;
+        }
+
+        void exportInt64(const std::string& name, int64_t value) override {
+            if (inEntry() && name == "compileTime") current.compileTime = value;
+        }
+
+        void exportString(const std::string& name, const std::string& value) override {
+            if (inEntry() && name == "assetNameWType") assetName = value;
+        }
+
+        void beginArray(const std::string& name) override {
+            arrays.push_back(name);
+        }
+
+        void beginArrayEntry() override {
+            if (inEntry()) {
+                assetName.clear();
+                current = CatalogRecord();
+            }
+        }
+
+        void endArrayEntry() override {
+            if (inEntry() && !assetName.empty()) {
+                records[CatalogSnapshot::keyFor(assetName)] = current;
+            }
+        }
+
+        void endArray() override {
+            if (!arrays.empty()) arrays.pop_back();
+        }
+
+        bool saveToFile(const std::string&) override {
+            return true;
+        }
+
+        bool saveToString(std::string& output) override {
+            output.clear();
+            return true;
+        }
+    };
+}
+
+std::string CatalogSnapshot::keyFor(const std::string& assetPath) {
+    std::string key = assetPath;
+    for (auto& c : key) {
+        c = c == '\\' ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return key;
+}
+
+bool CatalogSnapshot::readCatalog(const Catalog& catalog, const std::string& filepath) {
+    records.clear();
+    Parser parser(catalog, filepath, true, false, "none");
+    parser.setExporter(std::make_unique<CatalogCaptureExporter>(records));
+    return parser.parse() && !records.empty();
+}
+
+bool CatalogSnapshot::load(const std::string& filepath) {
+    records.clear();
+    std::ifstream in(filepath);
+    std::string line;
+    if (!std::getline(in, line) || line != SNAPSHOT_HEADER) {
+        return false;
+    }
+
+    // <compileTime>\t<dataCrc>\t<typeCrc>\t<schema hash>\t<output size>\t<output hash>\t<asset name>
+    while (std::getline(in, line)) {
+        const char* p = line.c_str();
+        char* end;
+        CatalogRecord record;
+        record.compileTime = std::strtoll(p, &end, 16);
+        if (*end != '\t') continue;
+        record.dataCrc = static_cast<uint32_t>(std::strtoul(end + 1, &end, 16));
+        if (*end != '\t') continue;
+        record.typeCrc = static_cast<uint32_t>(std::strtoul(end + 1, &end, 16));
+        if (*end != '\t') continue;
+        record.schemaHash = std::strtoull(end + 1, &end, 16);
+        if (*end != '\t') continue;
+        record.output.size = std::strtoull(end + 1, &end, 10);
+        if (*end != '\t') continue;
+        record.output.hash = std::strtoull(end + 1, &end, 16);
+        if (*end != '\t') continue;
+        records[end + 1] = record;
+    }
+    return true;
+}
+
+bool CatalogSnapshot::save(const std::string& filepath) const {
+    std::vector<const std::pair<const std::string, CatalogRecord>*> sorted;
+    for (const auto& pair : records) {
+        sorted.push_back(&pair);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->first < b->first; });
+
+    const std::string tempPath = filepath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << SNAPSHOT_HEADER << '\n';
+        for (const auto* pair : sorted) {
+            const CatalogRecord& record = pair->second;
+            out << fmt::format("{:x}\t{:08x}\t{:08x}\t{:016x}\t{}\t{:016x}\t{}\n", record.compileTime,
+                record.dataCrc, record.typeCrc, record.schemaHash, record.output.size, record.output.hash, pair->first);
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tempPath, filepath, ec);
+    return !ec;
+}
+
+const CatalogRecord* CatalogSnapshot::find(const std::string& assetPath) const {
+    auto it = records.find(keyFor(assetPath));
+    return it != records.end() ? &it->second : nullptr;
+}
+
+const CatalogRecord* CatalogSnapshot::findAsset(const std::string& assetPath) const {
+    if (const CatalogRecord* record = find(assetPath)) {
+        return record;
+    }
+    size_t slash = assetPath.find_last_of("/\\");
+    return slash == std::string::npos ? nullptr : find(assetPath.substr(slash + 1));
+}
+
+void CatalogSnapshot::set(const std::string& assetPath, const CatalogRecord& record) {
+    records[keyFor(assetPath)] = record;
+}
+
+void CatalogSnapshot::forget(const std::string& assetPath) {
+    records.erase(keyFor(assetPath));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "catalog.h"
+#include "export_cache.h"
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// Build information the game keeps for one asset in catalog_131.
+struct CatalogRecord {
+    int64_t compileTime = 0;
+    uint32_t dataCrc = 0;
+    uint32_t typeCrc = 0;
+    // Schema and output options the asset was last exported with, and what
+    // that export wrote; not part of catalog_131 itself.
+    uint64_t schemaHash = 0;
+    ExportedOutput output;
+
+    bool sameBuild(const CatalogRecord& other) const {
+        return compileTime == other.compileTime && dataCrc == other.dataCrc && typeCrc == other.typeCrc;
+    }
+};
+
+// Catalog records keyed by lowercase asset path with forward slashes, either
+// decoded from catalog_131, keyed by assetNameWType as the game wrote it, or
+// loaded from the snapshot a previous run left in the output directory, keyed
+// by the path below the input root. Same-named assets in different
+// directories keep their own records.
+class CatalogSnapshot {
+private:
+    std::unordered_map<std::string, CatalogRecord> records;
+
+public:
+    static std::string keyFor(const std::string& assetPath);
+
+    // Decodes catalog_131 through the regular parser.
+    bool readCatalog(const Catalog& catalog, const std::string& filepath);
+
+    bool load(const std::string& filepath);
+    bool save(const std::string& filepath) const;
+
+    const CatalogRecord* find(const std::string& assetPath) const;
+    // catalog_131 lookup by the path below the input root, falling back to
+    // the file name alone for entries that do not name a directory.
+    const CatalogRecord* findAsset(const std::string& assetPath) const;
+    void set(const std::string& assetPath, const CatalogRecord& record);
+    void forget(const std::string& assetPath);
+
+    size_t size() const {
+        return records.size();
+    }
+};
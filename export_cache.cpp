@@ -0,0 +1,107 @@
+#include "export_cache.h"
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <system_error>
+#include <fmt/format.h>
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+namespace {
+    constexpr const char* MANIFEST_HEADER = "recap_parser cache 2";
+}
+
+ExportCache::ExportCache(const std::string& manifestPath)
+    : manifestPath(manifestPath) {
+}
+
+void ExportCache::load() {
+    entries.clear();
+    std::ifstream in(manifestPath);
+    std::string line;
+    if (!std::getline(in, line) || line != MANIFEST_HEADER) {
+        return;
+    }
+
+    // <content hash>\t<schema hash>\t<output size>\t<output hash>\t<input path>
+    while (std::getline(in, line)) {
+        const char* p = line.c_str();
+        char* end;
+        Entry entry;
+        entry.contentHash = std::strtoull(p, &end, 16);
+        if (*end != '\t') continue;
+        entry.schemaHash = std::strtoull(end + 1, &end, 16);
+        if (*end != '\t') continue;
+        entry.output.size = std::strtoull(end + 1, &end, 10);
+        if (*end != '\t') continue;
+        entry.output.hash = std::strtoull(end + 1, &end, 16);
+        if (*end != '\t') continue;
+        entries[end + 1] = entry;
+    }
+}
+
+bool ExportCache::save() {
+    if (!dirty) {
+        return true;
+    }
+
+    // Written aside and renamed over the old manifest so an interrupted run
+    // never leaves a truncated one behind.
+    const std::string tempPath = manifestPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        std::vector<const std::pair<const std::string, Entry>*> sorted;
+        for (const auto& pair : entries) {
+            sorted.push_back(&pair);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->first < b->first; });
+
+        out << MANIFEST_HEADER << '\n';
+        for (const auto* pair : sorted) {
+            const Entry& entry = pair->second;
+            out << fmt::format("{:016x}\t{:016x}\t{}\t{:016x}\t{}\n", entry.contentHash, entry.schemaHash,
+                entry.output.size, entry.output.hash, pair->first);
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tempPath, manifestPath, ec);
+    if (ec) {
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool ExportCache::isFresh(const std::string& input, uint64_t contentHash, uint64_t schemaHash,
+    ExportedOutput* output) const {
+    auto it = entries.find(input);
+    if (it == entries.end() || it->second.contentHash != contentHash || it->second.schemaHash != schemaHash) {
+        return false;
+    }
+    if (output) *output = it->second.output;
+    return true;
+}
+
+void ExportCache::record(const std::string& input, uint64_t contentHash, uint64_t schemaHash, const ExportedOutput& output) {
+    entries[input] = Entry{ contentHash, schemaHash, output };
+    dirty = true;
+}
+
+void ExportCache::forget(const std::string& input) {
+    if (entries.erase(input) > 0) {
+        dirty = true;
+    }
+}
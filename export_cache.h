@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// Size and XXH64 of an exported document, so a skipped input can still
+// report its output without reading it back.
+struct ExportedOutput {
+    uint64_t size = 0;
+    uint64_t hash = 0;
+};
+
+// Manifest of earlier runs into one output directory. An input is up to date
+// when its content hash and the schema hash of its file type both match what
+// was recorded the last time it was exported.
+class ExportCache {
+private:
+    struct Entry {
+        uint64_t contentHash;
+        uint64_t schemaHash;
+        ExportedOutput output;
+    };
+
+    std::string manifestPath;
+    std::unordered_map<std::string, Entry> entries;
+    bool dirty = false;
+
+public:
+    explicit ExportCache(const std::string& manifestPath);
+
+    // A missing or unreadable manifest simply starts an empty cache.
+    void load();
+    bool save();
+
+    // If fresh and output is given, it receives what the last export wrote.
+    bool isFresh(const std::string& input, uint64_t contentHash, uint64_t schemaHash,
+        ExportedOutput* output = nullptr) const;
+    void record(const std::string& input, uint64_t contentHash, uint64_t schemaHash, const ExportedOutput& output);
+    void forget(const std::string& input);
+};
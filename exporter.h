@@ -4,9 +4,11 @@
 #include <string>
 #include <memory>
 #include <stack>
+#include <deque>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <pugixml.hpp>
 #include <fmt/format.h>
 #include <yaml-cpp/yaml.h>
@@ -42,6 +44,7 @@ public:
     virtual void endArray() = 0;
 
     virtual bool saveToFile(const std::string& filepath) = 0;
+    virtual bool saveToString(std::string& output) = 0;
 };
 
 class XmlExporter : public FormatExporter {
@@ -162,6 +165,13 @@ public:
         return xmlDoc.save_file(filepath.c_str());
     }
 
+    bool saveToString(std::string& output) override {
+        std::ostringstream stream;
+        xmlDoc.save(stream);
+        output = stream.str();
+        return true;
+    }
+
     pugi::xml_document& getDocument() {
         return xmlDoc;
     }
@@ -176,7 +186,8 @@ private:
     YAML::Node rootNode;
     std::vector<YAML::Node*> nodeStack;
     std::map<std::string, YAML::Node> namedNodes;
-    std::vector<YAML::Node> sequenceEntries;
+    // A deque, since nodeStack points into it while entries are appended.
+    std::deque<YAML::Node> sequenceEntries;
 
 public:
     YamlExporter() = default;
@@ -320,26 +331,43 @@ public:
 
     bool saveToFile(const std::string& filepath) override {
         try {
-            std::ofstream outFile(filepath);
+            // Binary, like write_document, so the bytes do not depend on
+            // which path wrote the file.
+            std::ofstream outFile(filepath, std::ios::binary);
             if (!outFile.is_open()) {
                 return false;
             }
 
-            YAML::Emitter emitter;
-            emitter.SetIndent(2);
-            emitter.SetMapFormat(YAML::Block);
-            emitter.SetSeqFormat(YAML::Block);
-            emitter << rootNode;
-
-            outFile << emitter.c_str();
+            outFile << emit();
             outFile.close();
-            return true;
+            return static_cast<bool>(outFile);
         }
         catch (const std::exception& e) {
             std::cerr << "Error saving YAML file: " << e.what() << std::endl;
             return false;
         }
     }
+
+    bool saveToString(std::string& output) override {
+        try {
+            output = emit();
+            return true;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error emitting YAML: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+private:
+    std::string emit() const {
+        YAML::Emitter emitter;
+        emitter.SetIndent(2);
+        emitter.SetMapFormat(YAML::Block);
+        emitter.SetSeqFormat(YAML::Block);
+        emitter << rootNode;
+        return emitter.c_str();
+    }
 };
 
 class ExporterFactory {
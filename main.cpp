@@ -6,13 +6,42 @@
 #include <algorithm>
 #include <cctype>
 #include <unordered_set>
+#include <unordered_map>
+#include <string_view>
 #include <system_error>
 #include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #include <CLI/CLI.hpp>
 
 #include "catalog.h"
 #include "exporter.h"
+#include "parse_trace.h"
+#include "package.h"
+#include "projection.h"
+#include "export_cache.h"
+#include "catalog_snapshot.h"
+#include "server.h"
+#include "watch.h"
+#include "work_queue.h"
+#include "tree_walker.h"
+#include "bulk_reader.h"
+#include "run_stats.h"
+#include "alloc_stats.h"
+#include "manifest.h"
+#include "timeline.h"
+#include "progress.h"
+#include "hash.h"
 
 #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
   #include <filesystem>
@@ -25,26 +54,68 @@
 struct TeeStreamBuffer : public std::streambuf {
     std::streambuf* a;
     std::streambuf* b;
+    char buffer[4096];
+
+    TeeStreamBuffer(std::streambuf* a_, std::streambuf* b_) : a(a_), b(b_) {
+        setp(buffer, buffer + sizeof(buffer));
+    }
 
-    TeeStreamBuffer(std::streambuf* a_, std::streambuf* b_) : a(a_), b(b_) {}
+    ~TeeStreamBuffer() override {
+        flushBuffer();
+    }
+
+    int flushBuffer() {
+        const std::streamsize n = pptr() - pbase();
+        if (n == 0) return 0;
+        const auto w1 = a ? a->sputn(pbase(), n) : n;
+        const auto w2 = b ? b->sputn(pbase(), n) : n;
+        setp(buffer, buffer + sizeof(buffer));
+        return (w1 == n && w2 == n) ? 0 : -1;
+    }
 
     int overflow(int c) override {
+        if (flushBuffer() != 0) return EOF;
         if (c == EOF) return !EOF;
-        const int r1 = a ? a->sputc(c) : c;
-        const int r2 = b ? b->sputc(c) : c;
-        return (r1 == EOF || r2 == EOF) ? EOF : c;
+        *pptr() = static_cast<char>(c);
+        pbump(1);
+        return c;
     }
 
     std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (n <= epptr() - pptr()) {
+            std::memcpy(pptr(), s, static_cast<size_t>(n));
+            pbump(static_cast<int>(n));
+            return n;
+        }
+        if (flushBuffer() != 0) return 0;
         const auto w1 = a ? a->sputn(s, n) : n;
         const auto w2 = b ? b->sputn(s, n) : n;
         return std::min(w1, w2);
     }
 
     int sync() override {
+        const int r0 = flushBuffer();
         const int r1 = a ? a->pubsync() : 0;
         const int r2 = b ? b->pubsync() : 0;
-        return (r1 == 0 && r2 == 0) ? 0 : -1;
+        return (r0 == 0 && r1 == 0 && r2 == 0) ? 0 : -1;
+    }
+};
+
+// Puts a stream's own buffer back when it goes out of scope, so no return
+// from main leaves a --log tee installed after the tee is destroyed.
+class StreamRestore {
+private:
+    std::ostream& stream;
+    std::streambuf* original;
+
+public:
+    explicit StreamRestore(std::ostream& s) : stream(s), original(s.rdbuf()) {
+    }
+    StreamRestore(const StreamRestore&) = delete;
+    StreamRestore& operator=(const StreamRestore&) = delete;
+
+    ~StreamRestore() {
+        stream.rdbuf(original);
     }
 };
 
@@ -76,11 +147,139 @@ static inline std::unordered_set<std::string> parse_ext_filter(const std::string
     return out;
 }
 
+static inline std::vector<std::string> parse_select_paths(const std::vector<std::string>& values) {
+    std::vector<std::string> out;
+    for (const auto& value : values) {
+        std::string tmp;
+        for (char c : value) {
+            if (c == ',' || std::isspace(static_cast<unsigned char>(c))) {
+                if (!tmp.empty()) { out.push_back(tmp); tmp.clear(); }
+            } else {
+                tmp.push_back(c);
+            }
+        }
+        if (!tmp.empty()) out.push_back(tmp);
+    }
+    return out;
+}
+
+static inline bool is_package(const fs::path& p) {
+    return to_lower(p.extension().string()) == ".package";
+}
+
+// --stats row of a file: its extension, or the whole name for exact-name types.
+static inline std::string stats_type(const fs::path& p) {
+    std::string e = to_lower(p.extension().string());
+    return e.size() > 1 ? e.substr(1) : to_lower(p.filename().string());
+}
+
+// --largest-first: a file to schedule, with its size and file type.
+struct ScheduledFile {
+    fs::path path;
+    uintmax_t size = 0;
+    const FileTypeInfo* type = nullptr;
+};
+
+// Largest first, so that one huge .Level found late does not run alone while
+// the other workers idle. Sizes within the same power of two count as equal,
+// and each such run is grouped by file type, so consecutive files handed to a
+// worker decode with the same, already cached, schema.
+static void order_largest_first(std::vector<ScheduledFile>& files) {
+    auto sizeClass = [](uintmax_t size) {
+        int bits = 0;
+        while (size >>= 1) bits++;
+        return bits;
+    };
+    std::stable_sort(files.begin(), files.end(), [&](const ScheduledFile& a, const ScheduledFile& b) {
+        int classA = sizeClass(a.size);
+        int classB = sizeClass(b.size);
+        if (classA != classB) return classA > classB;
+        if (a.type != b.type) return std::less<const FileTypeInfo*>()(a.type, b.type);
+        return a.size > b.size;
+    });
+}
+
+// Calls onPath for every entry of a list as soon as its separator arrives, so
+// a producer can still be writing the rest. Entries end at a NUL with
+// nulSeparated, where they are taken verbatim, otherwise at a newline, with
+// a trailing '\r' dropped.
+template<typename Callback>
+static void read_path_list(std::FILE* in, bool nulSeparated, Callback onPath) {
+    const int separator = nulSeparated ? '\0' : '\n';
+    auto finish = [&](std::string& entry) {
+        if (!nulSeparated && !entry.empty() && entry.back() == '\r') entry.pop_back();
+        if (!entry.empty()) onPath(fs::path(entry));
+        entry.clear();
+    };
+    std::string entry;
+    int c;
+    while ((c = std::fgetc(in)) != EOF) {
+        if (c != separator) {
+            entry.push_back(static_cast<char>(c));
+            continue;
+        }
+        finish(entry);
+    }
+    finish(entry);
+}
+
+// One asset to convert. path names a file on disk, or for in-memory and
+// streamed inputs a virtual path that only selects the file type and output name.
+struct InputItem {
+    fs::path path;
+    std::string_view bytes;
+    ChunkReader reader;
+    fs::path outputBase;
+    fs::path outputSubdir;
+};
+
+// --pipeline: an export waiting for the writer stage. done runs once the
+// document is on disk.
+struct PendingWrite {
+    fs::path outPath;
+    std::string document{};
+    std::function<void()> done{};
+    // Called instead of done when the write fails.
+    std::function<void()> failed{};
+    std::string statsType{};
+    // --manifest: the file's record, written once the write succeeded or failed.
+    std::optional<ManifestRecord> record{};
+};
+
+static inline bool write_document(const fs::path& outPath, const std::string& document) {
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    out.write(document.data(), static_cast<std::streamsize>(document.size()));
+    out.close();
+    return static_cast<bool>(out);
+}
+
 static inline void ensure_dir(const fs::path& p) {
     std::error_code ec;
     fs::create_directories(p, ec);
 }
 
+enum class DedupMode { None, Copy, Link };
+
+struct DedupOutput {
+    fs::path output;
+    size_t size;
+    double seconds;
+    ExportedOutput written;
+};
+
+static inline bool link_or_copy(const fs::path& from, const fs::path& to, bool link) {
+    std::error_code ec;
+    ensure_dir(to.parent_path());
+    fs::remove(to, ec);
+    if (link) {
+        fs::create_hard_link(from, to, ec);
+        if (!ec) return true;
+    }
+    ec.clear();
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    return !ec;
+}
+
 int main(int argc, char** argv) {
     CLI::App app{"ReCap Parser"};
 
@@ -95,8 +294,33 @@ int main(int argc, char** argv) {
     std::string gameVersion = "5.3.0.103";
     bool recursiveMode = false;
     std::string recursiveFilter;
+    std::string traceLogPath;
+    size_t traceRing = 0;
+    bool decodeTrace = false;
+    std::string stdinName;
+    std::vector<std::string> selectValues;
+    bool incremental = false;
+    std::string dedupValue;
+    std::string serveSocket;
+    std::string catalogDiffPath;
+    bool watchMode = false;
+    unsigned watchDelay = 200;
+    unsigned jobs = 0;
+    std::string filesFrom;
+    bool nullSeparated = false;
+    bool pipelineMode = false;
+    unsigned readThreads = 2;
+    unsigned writeThreads = 1;
+    std::string readerName = "auto";
+    bool largestFirst = false;
+    bool trackAllocs = false;
+    bool showProgress = false;
+    std::string statsPath;
+    std::string timelinePath;
+    std::string foldedPath;
+    std::string manifestPath;
 
-    app.add_option("file", inputPath)->required();
+    app.add_option("file", inputPath);
     app.add_flag("--xml", xmlMode);
     app.add_flag("--yaml,--yml,-y", yamlMode);
     app.add_flag("--silent", silentMode);
@@ -106,10 +330,73 @@ int main(int argc, char** argv) {
     app.add_flag("--sort-ext,-s", organizeByExtension);
     app.add_option("--game-version,--gv", gameVersion);
     CLI::Option* optRecursive = app.add_option("--recursive,-r", recursiveFilter)->expected(0,1);
+    app.add_option("--trace-log", traceLogPath, "Write a binary parse trace to this file");
+    app.add_option("--trace-ring", traceRing, "Keep only the last N trace records per file");
+    app.add_flag("--decode-trace", decodeTrace, "Render a binary parse trace given as <file> to text");
+    app.add_option("--stdin-name", stdinName, "Asset name used to pick the file type when <file> is -");
+    app.add_option("--select", selectValues, "Only decode these paths, e.g. Noun.assetId (repeatable, comma separated)")->allow_extra_args(false);
+    app.add_flag("--incremental", incremental, "Skip inputs unchanged since the last export into the same output directory");
+    CLI::Option* optCatalogDiff = app.add_option("--catalog-diff", catalogDiffPath,
+        "Only process assets whose catalog_131 entry changed since the last run (default: <file>/catalog_131)")->expected(0,1);
+    CLI::Option* optDedup = app.add_option("--dedup", dedupValue,
+        "Parse byte-identical inputs once and copy (or with 'link' hard-link) the output to the duplicates")->expected(0,1);
+    CLI::Option* optServe = app.add_option("--serve", serveSocket,
+        "Stay resident and answer parse requests on stdin/stdout, or on this Unix socket")->expected(0,1);
+    app.add_flag("--watch", watchMode, "Keep running and re-export files as they change under the <file> directory");
+    app.add_option("--watch-delay", watchDelay, "Milliseconds without changes before a --watch batch starts (default 200)");
+    app.add_option("--jobs,-j", jobs, "Worker threads for -r, --watch and --files-from batches (default: one per core, one without --silent)");
+    app.add_option("--files-from", filesFrom, "Convert the files listed in this file, or on stdin with -, one per line");
+    app.add_flag("--null,-0", nullSeparated, "--files-from entries are separated by NUL bytes instead of newlines, as from find -print0");
+    app.add_flag("--pipeline", pipelineMode, "Split -r and --files-from batches into reader, parser (-j) and writer threads");
+    app.add_option("--read-threads", readThreads, "Reader threads for --pipeline (default 2)");
+    app.add_option("--write-threads", writeThreads, "Writer threads for --pipeline (default 1)");
+    app.add_option("--reader", readerName, "How --pipeline reads files: auto, uring or pread (default auto)");
+    app.add_flag("--largest-first", largestFirst, "Collect -r and --files-from batches first, then start with the largest files");
+    CLI::Option* optStats = app.add_option("--stats", statsPath,
+        "Print per file type counts and timings at the end; with a path, also write them there as JSON")->expected(0, 1);
+    app.add_flag("--progress", showProgress, "Show files done, throughput, ETA and busy workers on stderr during -r and --files-from runs");
+    app.add_flag("--track-allocs", trackAllocs, "Count heap allocations per file and phase in the --stats report (implies --stats)");
+    CLI::Option* optProfileSchema = app.add_option("--profile-schema", foldedPath,
+        "Rank catalog structs and member types by decode time; with a path, also write folded stacks there")->expected(0, 1);
+    app.add_option("--manifest", manifestPath, "Write one JSON line per input with its hashes, output, status and timings to this file");
+    app.add_option("--trace", timelinePath, "Write a Chrome/Perfetto trace of files, phases and large struct decodes to this file");
     CLI11_PARSE(app, argc, argv);
     recursiveMode = optRecursive->count() > 0;
     if (xmlMode && yamlMode) { std::cerr << "Error: --xml and --yaml are mutually exclusive\n"; return 1; }
+    const bool serveMode = optServe->count() > 0;
+    const bool listMode = !filesFrom.empty();
+    if (listMode && !inputPath.empty()) { std::cerr << "Error: --files-from replaces <file>\n"; return 1; }
+    if (inputPath.empty() && !serveMode && !listMode) { std::cerr << "Error: <file> is required\n"; return 1; }
+    ReadBackend readBackend = ReadBackend::Auto;
+    if (readerName == "uring") readBackend = ReadBackend::Uring;
+    else if (readerName == "pread") readBackend = ReadBackend::Pread;
+    else if (readerName != "auto") { std::cerr << "Error: --reader expects auto, uring or pread\n"; return 1; }
+    if (readBackend == ReadBackend::Uring && !BulkReader::uringAvailable()) {
+        std::cerr << "Error: --reader uring: io_uring is not available here\n";
+        return 1;
+    }
+    DedupMode dedupMode = DedupMode::None;
+    if (optDedup->count() > 0) {
+        if (dedupValue.empty() || dedupValue == "copy") dedupMode = DedupMode::Copy;
+        else if (dedupValue == "link") dedupMode = DedupMode::Link;
+        else { std::cerr << "Error: --dedup expects 'copy' or 'link'\n"; return 1; }
+    }
+
 
+    if (decodeTrace) {
+        bool decoded;
+        try {
+            decoded = ParseTraceLog::decode(inputPath, stdout, debugMode);
+        }
+        catch (const std::bad_alloc&) {
+            decoded = false;
+        }
+        if (!decoded) {
+            std::cerr << "Error: not a valid trace log: " << inputPath << "\n";
+            return 1;
+        }
+        return 0;
+    }
 
     std::string exportFormat = "none";
     if (xmlMode) exportFormat = "xml";
@@ -120,10 +407,14 @@ int main(int argc, char** argv) {
     std::streambuf* cerrOrig = nullptr;
     std::unique_ptr<TeeStreamBuffer> teeOut;
     std::unique_ptr<TeeStreamBuffer> teeErr;
+    std::optional<StreamRestore> restoreOut;
+    std::optional<StreamRestore> restoreErr;
 
     if (logEnabled) {
         logFile.open("recap_parser.log", std::ios::out | std::ios::trunc);
         if (logFile.is_open()) {
+            restoreOut.emplace(std::cout);
+            restoreErr.emplace(std::cerr);
             coutOrig = std::cout.rdbuf();
             cerrOrig = std::cerr.rdbuf();
             teeOut = std::make_unique<TeeStreamBuffer>(coutOrig, logFile.rdbuf());
@@ -133,80 +424,835 @@ int main(int argc, char** argv) {
         }
     }
 
+    std::unique_ptr<ParseTraceLog> traceLog;
+    if (!traceLogPath.empty()) {
+        traceLog = std::make_unique<ParseTraceLog>(traceLogPath, traceRing > 0 ? traceRing : 65536, traceRing > 0);
+        if (!traceLog->isOpen()) {
+            std::cerr << "Error: cannot open trace log: " << traceLogPath << "\n";
+            return 1;
+        }
+    }
+
+    // Shared by the worker threads: failures, cache state and counters.
+    std::mutex stateMutex;
+    using StateLock = std::lock_guard<std::mutex>;
     std::vector<std::string> failedFiles;
+    auto add_failure = [&](const std::string& path) {
+        StateLock lock(stateMutex);
+        failedFiles.push_back(path);
+    };
     std::unordered_set<std::string> extFilter = parse_ext_filter(recursiveFilter);
 
-    fs::path in = inputPath;
-    if (!fs::exists(in)) {
-        std::cerr << "Error: path not found: " << inputPath << "\n";
-        if (logFile.is_open()) {
-            std::cout.rdbuf(coutOrig);
-            std::cerr.rdbuf(cerrOrig);
+    std::unique_ptr<RunStats> runStats;
+    if (optStats->count() > 0 || trackAllocs) runStats = std::make_unique<RunStats>();
+    if (trackAllocs) {
+        alloc_stats::enable();
+        runStats->showAllocations();
+    }
+    std::unique_ptr<Timeline> timeline;
+    if (!timelinePath.empty()) timeline = std::make_unique<Timeline>();
+    std::unique_ptr<SchemaProfile> schemaProfile;
+    if (optProfileSchema->count() > 0) schemaProfile = std::make_unique<SchemaProfile>();
+    std::unique_ptr<ResultManifest> manifest;
+    if (!manifestPath.empty()) {
+        manifest = std::make_unique<ResultManifest>(manifestPath);
+        if (!manifest->isOpen()) {
+            std::cerr << "Error: cannot open manifest: " << manifestPath << "\n";
+            return 1;
+        }
+    }
+    // An input that never reached the parser still gets its manifest record.
+    auto add_input_failure = [&](const fs::path& path) {
+        add_failure(path.string());
+        if (manifest) {
+            ManifestRecord record;
+            record.input = path.string();
+            record.type = stats_type(path);
+            manifest->write(record);
         }
+    };
+    auto runStarted = std::chrono::steady_clock::now();
+
+    fs::path in = listMode ? fs::path(".") : fs::path(inputPath);
+    if (!serveMode && inputPath != "-" && !fs::exists(in)) {
+        std::cerr << "Error: path not found: " << inputPath << "\n";
         return 1;
     }
 
-    auto process_one = [&](const fs::path& file) {
-        Catalog tempCatalog;
-        tempCatalog.setGameVersion(gameVersion);
+    Catalog catalog;
+    catalog.setGameVersion(gameVersion);
+
+    std::unique_ptr<Projection> projection;
+    std::vector<std::string> selectPaths = parse_select_paths(selectValues);
+    if (!selectPaths.empty()) {
+        std::string error;
+        projection = Projection::compile(catalog, selectPaths, error);
+        if (!projection) {
+            std::cerr << "Error: --select: " << error << "\n";
+            return 1;
+        }
+    }
+
+    if (serveMode) {
+        ParseServer server(catalog, projection.get());
+        if (serveSocket.empty()) {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            server.serve(stdin, stdout);
+            return 0;
+        }
+        std::string error;
+        if (!server.serveSocket(serveSocket, error)) {
+            std::cerr << "Error: --serve: " << error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // Both incremental modes keep their state next to the exported files and
+    // key it by the schema of the file type plus the options that shape the output.
+    fs::path stateDir = !outputDir.empty() ? fs::path(outputDir) : fs::is_directory(in) ? in : in.parent_path();
+    uint64_t optionsHash = 0;
+    {
+        std::string options = exportFormat + (organizeByExtension ? "|sort-ext" : "|");
+        for (const auto& path : selectPaths) options += "|" + path;
+        optionsHash = xxh64(options);
+    }
+    std::unordered_map<const FileTypeInfo*, uint64_t> schemaHashes;
+    auto schema_hash_for = [&](const fs::path& file) {
+        const FileTypeInfo* fileType = catalog.findFileType(file.string());
+        StateLock lock(stateMutex);
+        auto known = schemaHashes.find(fileType);
+        if (known == schemaHashes.end()) {
+            known = schemaHashes.emplace(fileType, catalog.getSchemaHash(fileType) ^ optionsHash).first;
+        }
+        return known->second;
+    };
+    size_t unchangedFiles = 0;
+
+    // --dedup: first export of each distinct payload, keyed by content and schema hash.
+    std::unordered_map<uint64_t, DedupOutput> dedupOutputs;
+    size_t duplicateFiles = 0;
+    double dedupSavedSeconds = 0;
+
+    std::unique_ptr<ExportCache> exportCache;
+    if (incremental && exportFormat != "none") {
+        ensure_dir(stateDir);
+        exportCache = std::make_unique<ExportCache>((stateDir / ".recap_cache").string());
+        exportCache->load();
+    }
+
+    // catalog_131 lists dataCrc/typeCrc/compileTime for every asset, so
+    // unchanged assets are skipped before their bytes are even read.
+    std::unique_ptr<CatalogSnapshot> currentCatalog;
+    CatalogSnapshot previousCatalog;
+    CatalogSnapshot nextCatalog;
+    // Snapshot records are keyed by the asset's path below this root.
+    fs::path catalogRoot;
+    if (optCatalogDiff->count() > 0 && exportFormat != "none") {
+        fs::path catalogPath = !catalogDiffPath.empty() ? fs::path(catalogDiffPath) : in / "catalog_131";
+        currentCatalog = std::make_unique<CatalogSnapshot>();
+        if (!currentCatalog->readCatalog(catalog, catalogPath.string())) {
+            std::cerr << "Error: cannot read catalog: " << catalogPath << "\n";
+            return 1;
+        }
+        ensure_dir(stateDir);
+        previousCatalog.load((stateDir / ".recap_catalog").string());
+        nextCatalog = previousCatalog;
+        catalogRoot = fs::absolute(fs::is_directory(in) ? in : in.parent_path()).lexically_normal();
+    }
+    auto asset_key = [&](const fs::path& file) {
+        fs::path relative = fs::absolute(file).lexically_normal().lexically_relative(catalogRoot);
+        if (relative.empty() || *relative.begin() == "..") return file.generic_string();
+        return relative.generic_string();
+    };
+
+    auto output_path = [&](const InputItem& item) {
+        const fs::path& file = item.path;
+        fs::path baseOut = !outputDir.empty() ? fs::path(outputDir) :
+            !item.outputBase.empty() ? item.outputBase : file.parent_path();
+        fs::path targetDir = baseOut / item.outputSubdir;
+        if (organizeByExtension) {
+            std::string e = to_lower(file.extension().string());
+            if (!e.empty() && e[0]=='.') e.erase(0,1);
+            targetDir /= e.empty() ? "unknown" : e;
+        }
+
+        fs::path outName = file.stem();
+        if (exportFormat == "xml") outName += ".xml";
+        else if (exportFormat == "yaml") outName += ".yaml";
+        return targetDir / outName;
+    };
+
+    auto record_export = [&](const fs::path& file, const CatalogRecord* built, const std::string& cacheKey,
+        uint64_t contentHash, uint64_t schemaHash, const ExportedOutput& written) {
+        uint64_t builtSchema = built ? schema_hash_for(file) : 0;
+        StateLock lock(stateMutex);
+        if (exportCache && !cacheKey.empty()) exportCache->record(cacheKey, contentHash, schemaHash, written);
+        if (built) {
+            CatalogRecord record = *built;
+            record.schemaHash = builtSchema;
+            record.output = written;
+            nextCatalog.set(asset_key(file), record);
+        }
+    };
+
+    // A file whose output was not written must be exported again next run.
+    auto forget_export = [&](const std::string& cacheKey, const std::string& assetKey) {
+        StateLock lock(stateMutex);
+        if (exportCache && !cacheKey.empty()) exportCache->forget(cacheKey);
+        if (!assetKey.empty()) nextCatalog.forget(assetKey);
+    };
+
+    // Set while a --pipeline batch runs; exports are then queued for its writers.
+    PipelineStage<PendingWrite>* writeStage = nullptr;
+    // Set while a batch runs with --progress.
+    std::unique_ptr<ProgressReporter> progress;
+
+    // Documents are rendered to memory before they are written when they are
+    // timed, or when their size and hash are kept for the manifest, the
+    // incremental state or --dedup.
+    const bool hashOutput = manifest || exportCache || currentCatalog || dedupMode != DedupMode::None;
+    const bool renderToMemory = hashOutput || runStats || timeline;
+
+    auto process_one = [&](const InputItem& item) {
+        const fs::path& file = item.path;
+        std::optional<Timeline::Scope> fileSpan;
+        if (timeline) fileSpan.emplace(timeline.get(), "file", file.filename().string(), file.string());
+        ResultManifest::Entry entry(manifest.get());
+        if (entry.active()) {
+            const VersionedFileTypeInfo* versioned = catalog.getVersionedFileTypeInfo(catalog.findFileType(file.string()));
+            entry.record.input = file.string();
+            entry.record.type = stats_type(file);
+            entry.record.version = versioned ? versioned->version : catalog.getGameVersion();
+        }
+        const std::string assetKey = currentCatalog && !item.reader ? asset_key(file) : std::string();
+        std::string cacheKey;
         try {
-            Parser parser(tempCatalog, file.string(), silentMode, debugMode, exportFormat);
-            if (!parser.parse()) {
+            std::string_view bytes = item.bytes;
+            MappedFile mapped;
+            uint64_t contentHash = 0;
+            uint64_t schemaHash = 0;
+            const CatalogRecord* built = !assetKey.empty() ? currentCatalog->findAsset(assetKey) : nullptr;
+            if (built) {
+                const CatalogRecord* exported = previousCatalog.find(assetKey);
+                if (exported && exported->sameBuild(*built) && exported->schemaHash == schema_hash_for(file) &&
+                    fs::exists(output_path(item))) {
+                    if (entry.active()) {
+                        std::error_code ec;
+                        entry.record.inputBytes = fs::file_size(file, ec);
+                        entry.record.status = "unchanged";
+                        entry.record.setOutput(output_path(item).string(), exported->output.size, exported->output.hash);
+                    }
+                    StateLock lock(stateMutex);
+                    nextCatalog.set(assetKey, *exported);
+                    unchangedFiles++;
+                    return;
+                }
+            }
+
+
+            const bool hashInput = (exportCache || dedupMode != DedupMode::None || manifest) && !item.reader;
+            if (hashInput) {
+                if (!bytes.data()) {
+                    if (!mapped.open(file.string())) {
+                        add_failure(file.string());
+                        return;
+                    }
+                    bytes = std::string_view(mapped.getData(), mapped.getSize());
+                }
+
+                cacheKey = fs::absolute(file).lexically_normal().string();
+                contentHash = xxh64(bytes.data(), bytes.size());
+                schemaHash = schema_hash_for(file);
+                if (entry.active()) {
+                    entry.record.inputBytes = bytes.size();
+                    entry.record.inputHash = contentHash;
+                    entry.record.inputHashed = true;
+                }
+                bool fresh = false;
+                ExportedOutput cached;
+                if (exportCache) {
+                    StateLock lock(stateMutex);
+                    fresh = exportCache->isFresh(cacheKey, contentHash, schemaHash, &cached);
+                }
+                if (fresh && fs::exists(output_path(item))) {
+                    if (entry.active()) {
+                        entry.record.status = "unchanged";
+                        entry.record.setOutput(output_path(item).string(), cached.size, cached.hash);
+                    }
+                    record_export(file, built, cacheKey, contentHash, schemaHash, cached);
+                    StateLock lock(stateMutex);
+                    unchangedFiles++;
+                    return;
+                }
+            }
+
+            // Identical bytes of the same file type give identical output, so
+            // a duplicate reuses the first copy's export.
+            uint64_t dedupKey = 0;
+            if (dedupMode != DedupMode::None && hashInput) {
+                dedupKey = xxh64(&schemaHash, sizeof(schemaHash), contentHash);
+                std::optional<DedupOutput> original;
+                {
+                    StateLock lock(stateMutex);
+                    auto found = dedupOutputs.find(dedupKey);
+                    if (found != dedupOutputs.end() && found->second.size == bytes.size()) original = found->second;
+                }
+                if (original) {
+                    fs::path outPath = output_path(item);
+                    if (outPath == original->output ||
+                        link_or_copy(original->output, outPath, dedupMode == DedupMode::Link)) {
+                        if (entry.active()) {
+                            entry.record.status = "duplicate";
+                            entry.record.setOutput(outPath.string(), original->written.size, original->written.hash);
+                            entry.record.sameAs = original->output.string();
+                        }
+                        record_export(file, built, cacheKey, contentHash, schemaHash, original->written);
+                        StateLock lock(stateMutex);
+                        duplicateFiles++;
+                        dedupSavedSeconds += original->seconds;
+                        return;
+                    }
+                }
+            }
+
+            // --track-allocs: one meter for the whole file, one for the phase.
+            std::optional<AllocMeter> fileAllocs;
+            std::optional<AllocMeter> phaseAllocs;
+            if (trackAllocs) {
+                fileAllocs.emplace();
+                phaseAllocs.emplace();
+            }
+            auto started = std::chrono::steady_clock::now();
+            Parser parser(catalog, file.string(), silentMode, debugMode, exportFormat);
+            parser.setTraceLog(traceLog.get());
+            parser.setProjection(projection.get());
+            parser.setTimeline(timeline.get());
+            parser.setSchemaProfile(schemaProfile.get());
+            bool parsed;
+            if (item.reader) parsed = parser.parse(item.reader);
+            else if (bytes.data()) parsed = parser.parse(bytes.data(), bytes.size());
+            else parsed = parser.parse();
+            if (timeline) timeline->span("phase", "parse", started, std::chrono::steady_clock::now());
+            if (progress) progress->addBytes(parser.getInputBytes());
+            if (entry.active()) {
+                entry.record.inputBytes = parser.getInputBytes();
+                entry.record.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            }
+            if (!parsed) {
+                StateLock lock(stateMutex);
                 failedFiles.push_back(file.string());
+                if (exportCache) exportCache->forget(cacheKey);
+                if (built) nextCatalog.forget(assetKey);
                 return;
             }
+            FileTypeStats* stats = nullptr;
+            if (runStats) {
+                std::chrono::duration<double> decoded = std::chrono::steady_clock::now() - started;
+                AllocUsage decodeAllocs = phaseAllocs ? phaseAllocs->stop() : AllocUsage{};
+                stats = &runStats->local(stats_type(file));
+                stats->files++;
+                stats->inputBytes += parser.getInputBytes();
+                stats->fields += parser.getFieldsDecoded();
+                stats->strings += parser.getStringsRead();
+                stats->decodeSeconds += decoded.count();
+                if (phaseAllocs) {
+                    stats->decodeAllocs.add(decodeAllocs);
+                    phaseAllocs.emplace();
+                }
+            }
             if (exportFormat != "none") {
-                fs::path baseOut = outputDir.empty() ? file.parent_path() : fs::path(outputDir);
-                fs::path targetDir = baseOut;
-                if (organizeByExtension) {
-                    std::string e = to_lower(file.extension().string());
-                    if (!e.empty() && e[0]=='.') e.erase(0,1);
-                    targetDir /= e.empty() ? "unknown" : e;
+                fs::path outPath = output_path(item);
+                ensure_dir(outPath.parent_path());
+                if (dedupMode == DedupMode::Link) {
+                    // Never write through a hard link left by an earlier run.
+                    std::error_code ec;
+                    fs::remove(outPath, ec);
+                }
+                if (writeStage) {
+                    PendingWrite write{ outPath };
+                    auto formatStarted = std::chrono::steady_clock::now();
+                    if (!parser.exportToString(write.document)) {
+                        add_failure(file.string());
+                        forget_export(cacheKey, assetKey);
+                        return;
+                    }
+                    if (timeline) timeline->span("phase", "format", formatStarted, std::chrono::steady_clock::now());
+                    ExportedOutput written;
+                    if (hashOutput) written = ExportedOutput{ write.document.size(), xxh64(write.document.data(), write.document.size()) };
+                    if (entry.active()) {
+                        entry.record.setOutput(outPath.string(), written.size, written.hash);
+                        entry.record.formatSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - formatStarted).count();
+                        write.record = entry.release();
+                    }
+                    if (stats) {
+                        std::chrono::duration<double> formatted = std::chrono::steady_clock::now() - formatStarted;
+                        stats->formatSeconds += formatted.count();
+                        write.statsType = stats_type(file);
+                        if (phaseAllocs) {
+                            stats->formatAllocs.add(phaseAllocs->stop());
+                            stats->notePeak(fileAllocs->stop(), file.string());
+                        }
+                    }
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+                    bool remember = dedupMode != DedupMode::None && hashInput;
+                    size_t size = bytes.size();
+                    write.done = [&, file, built, cacheKey, contentHash, schemaHash, remember, dedupKey, outPath, size, elapsed, written]() {
+                        record_export(file, built, cacheKey, contentHash, schemaHash, written);
+                        if (remember) {
+                            StateLock lock(stateMutex);
+                            dedupOutputs.emplace(dedupKey, DedupOutput{ outPath, size, elapsed.count(), written });
+                        }
+                    };
+                    write.failed = [&, cacheKey, assetKey]() {
+                        forget_export(cacheKey, assetKey);
+                    };
+                    writeStage->push(std::move(write));
+                    return;
+                }
+
+                ExportedOutput written;
+                if (renderToMemory) {
+                    // Rendered to memory first, so formatting and writing are timed apart
+                    // and the output can be hashed.
+                    auto formatStarted = std::chrono::steady_clock::now();
+                    std::string document;
+                    if (!parser.exportToString(document)) {
+                        add_failure(file.string());
+                        forget_export(cacheKey, assetKey);
+                        return;
+                    }
+                    AllocUsage formatAllocs;
+                    if (phaseAllocs) {
+                        formatAllocs = phaseAllocs->stop();
+                        phaseAllocs.emplace();
+                    }
+                    auto writeStarted = std::chrono::steady_clock::now();
+                    if (!write_document(outPath, document)) {
+                        add_failure(outPath.string());
+                        forget_export(cacheKey, assetKey);
+                        std::cerr << "Write failed: " << outPath << "\n";
+                        return;
+                    }
+                    auto writeEnded = std::chrono::steady_clock::now();
+                    if (hashOutput) written = ExportedOutput{ document.size(), xxh64(document.data(), document.size()) };
+                    if (entry.active()) {
+                        entry.record.status = "ok";
+                        entry.record.setOutput(outPath.string(), written.size, written.hash);
+                        entry.record.formatSeconds = std::chrono::duration<double>(writeStarted - formatStarted).count();
+                        entry.record.writeSeconds = std::chrono::duration<double>(writeEnded - writeStarted).count();
+                    }
+                    if (timeline) {
+                        timeline->span("phase", "format", formatStarted, writeStarted);
+                        timeline->span("phase", "write", writeStarted, writeEnded);
+                    }
+                    if (stats) {
+                        std::chrono::duration<double> formatted = writeStarted - formatStarted;
+                        std::chrono::duration<double> written = writeEnded - writeStarted;
+                        stats->formatSeconds += formatted.count();
+                        stats->writeSeconds += written.count();
+                        stats->outputBytes += document.size();
+                        if (phaseAllocs) {
+                            stats->formatAllocs.add(formatAllocs);
+                            stats->writeAllocs.add(phaseAllocs->stop());
+                            stats->notePeak(fileAllocs->stop(), file.string());
+                        }
+                    }
+                }
+                else if (!parser.exportToFile(outPath.string())) {
+                    add_failure(outPath.string());
+                    forget_export(cacheKey, assetKey);
+                    std::cerr << "Write failed: " << outPath << "\n";
+                    return;
                 }
-                ensure_dir(targetDir);
+                record_export(file, built, cacheKey, contentHash, schemaHash, written);
 
-                fs::path outName = file.stem();
-                if (exportFormat == "xml") outName += ".xml";
-                else if (exportFormat == "yaml") outName += ".yaml";
-                fs::path outPath = targetDir / outName;
-                parser.exportToFile(outPath.string());
+                if (dedupMode != DedupMode::None && hashInput) {
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+                    StateLock lock(stateMutex);
+                    dedupOutputs.emplace(dedupKey, DedupOutput{ outPath, bytes.size(), elapsed.count(), written });
+                }
+            }
+            else {
+                entry.record.status = "ok";
+                if (fileAllocs) stats->notePeak(fileAllocs->stop(), file.string());
             }
         } catch (const std::exception& e) {
+            StateLock lock(stateMutex);
             failedFiles.push_back(file.string());
+            if (exportCache && !cacheKey.empty()) exportCache->forget(cacheKey);
+            if (!assetKey.empty()) nextCatalog.forget(assetKey);
             if (!silentMode) std::cerr << "Parse failed: " << file << " : " << e.what() << "\n";
         }
     };
 
-    if (fs::is_regular_file(in)) {
-        process_one(in);
+
+    // Package entries carry hashed names: types map back to registered
+    // extensions, exact-name assets (catalog_131) are matched by instance.
+    std::unordered_map<uint32_t, std::string> packageTypeNames;
+    for (const auto& ext : catalog.getRegisteredExtensions()) {
+        packageTypeNames.emplace(packageHash(ext.substr(ext[0] == '.' ? 1 : 0)), ext);
+    }
+    std::unordered_map<uint32_t, std::string> packageFileNames;
+    for (const auto& name : catalog.getRegisteredFileNames()) {
+        packageFileNames.emplace(packageHash(name), name);
+    }
+
+    auto process_package = [&](const fs::path& packagePath) {
+        // A corrupt archive must not take the rest of the batch down with it.
+        try {
+            DbpfPackage package;
+            std::string error;
+            if (!package.open(packagePath.string(), error)) {
+                add_input_failure(packagePath);
+                std::cerr << "Package failed: " << packagePath << " : " << error << "\n";
+                return;
+            }
+
+            std::vector<char> scratch;
+            for (const auto& entry : package.getEntries()) {
+                std::string name;
+                auto named = packageFileNames.find(entry.instanceId);
+                if (named != packageFileNames.end()) {
+                    name = named->second;
+                } else {
+                    auto type = packageTypeNames.find(entry.typeId);
+                    if (type == packageTypeNames.end()) continue;
+                    name = fmt::format("0x{:08X}{}", entry.instanceId, type->second);
+                }
+                if (!has_any_extension(name, extFilter)) continue;
+
+                const std::string group = fmt::format("0x{:08X}", entry.groupId);
+                InputItem item;
+                item.path = packagePath / group / name;
+                item.outputBase = packagePath.parent_path();
+                item.outputSubdir = fs::path(packagePath.stem()) / group;
+
+                if (!package.readEntry(entry, scratch, item.bytes, error)) {
+                    add_input_failure(item.path);
+                    std::cerr << "Package entry failed: " << item.path << " : " << error << "\n";
+                    continue;
+                }
+                process_one(item);
+            }
+        } catch (const std::exception& e) {
+            add_input_failure(packagePath);
+            std::cerr << "Package failed: " << packagePath << " : " << e.what() << "\n";
+        }
+    };
+
+    auto process_path = [&](const fs::path& file) {
+        if (is_package(file)) {
+            process_package(file);
+        } else {
+            InputItem item;
+            item.path = file;
+            process_one(item);
+        }
+    };
+
+    // Without --silent every file prints its parse trace to stdout as it goes,
+    // so by default only one file runs at a time and the traces stay readable.
+    const bool liveTrace = RECAP_PARSE_TRACE && !silentMode;
+    const size_t threadCount = traceLog ? 1 :  // the trace log is a single stream
+        jobs > 0 ? jobs : liveTrace ? 1 : std::max(1u, std::thread::hardware_concurrency());
+
+    // Runs every file that produce() hands over, either on one worker pool or
+    // with --pipeline split into reader, parser and writer stages, so the disk
+    // and the CPUs stay busy at the same time.
+    using FileSink = std::function<void(fs::path)>;
+    auto dispatch_batch = [&](const std::function<void(const FileSink&)>& produce) {
+        if (!pipelineMode) {
+            WorkerPool<fs::path> pool(threadCount, threadCount * 4, [&](fs::path& file) {
+                ProgressReporter::Task task(progress.get());
+                process_path(file);
+            });
+            produce([&](fs::path file) { pool.submit(std::move(file)); });
+            pool.wait();
+            return;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        PipelineStage<PendingWrite> writers("write", writeThreads, threadCount * 2, [&](PendingWrite& write) {
+            std::optional<AllocMeter> writeAllocs;
+            if (trackAllocs) writeAllocs.emplace();
+            auto writeStarted = std::chrono::steady_clock::now();
+            if (!write_document(write.outPath, write.document)) {
+                add_failure(write.outPath.string());
+                std::cerr << "Write failed: " << write.outPath << "\n";
+                if (write.record) manifest->write(*write.record);
+                write.failed();
+                return;
+            }
+            auto writeEnded = std::chrono::steady_clock::now();
+            if (write.record) {
+                write.record->status = "ok";
+                write.record->writeSeconds = std::chrono::duration<double>(writeEnded - writeStarted).count();
+                manifest->write(*write.record);
+            }
+            if (timeline) timeline->span("phase", "write", writeStarted, writeEnded, write.outPath.string());
+            if (runStats && !write.statsType.empty()) {
+                std::chrono::duration<double> written = writeEnded - writeStarted;
+                FileTypeStats& stats = runStats->local(write.statsType);
+                stats.writeSeconds += written.count();
+                stats.outputBytes += write.document.size();
+                if (writeAllocs) stats.writeAllocs.add(writeAllocs->stop());
+            }
+            write.done();
+        });
+        PipelineStage<LoadedFile> parsers("parse", threadCount, threadCount * 2, [&](LoadedFile& input) {
+            ProgressReporter::Task task(progress.get());
+            if (is_package(input.path)) {
+                process_package(input.path);
+                return;
+            }
+            InputItem item;
+            item.path = input.path;
+            if (input.loaded) item.bytes = std::string_view(input.data.data(), input.data.size());
+            process_one(item);
+        });
+        // Readers take whatever is queued, up to 64 files, and read it with one
+        // BulkReader call: a few io_uring submissions instead of four syscalls a file.
+        PipelineStage<LoadedFile> readers("read", readThreads, 256, 64, [&](std::vector<LoadedFile>& batch) {
+            thread_local BulkReader bulkReader(readBackend);
+            std::vector<LoadedFile*> wanted;
+            for (auto& input : batch) {
+                // Packages are read entry by entry, and assets that catalog_131
+                // may prove unchanged should not be read at all.
+                bool skip = is_package(input.path) || (currentCatalog && currentCatalog->findAsset(asset_key(input.path)));
+                if (!skip) wanted.push_back(&input);
+            }
+            auto readStarted = std::chrono::steady_clock::now();
+            bulkReader.read(wanted);
+            if (timeline) {
+                timeline->span("phase", fmt::format("read {} file(s)", wanted.size()), readStarted,
+                    std::chrono::steady_clock::now());
+            }
+            for (auto& input : batch) {
+                parsers.push(std::move(input));
+            }
+        });
+
+        writeStage = &writers;
+        produce([&](fs::path file) { readers.push(LoadedFile{ std::move(file) }); });
+        readers.finish();
+        parsers.finish();
+        writers.finish();
+        writeStage = nullptr;
+
+        if (!silentMode) {
+            std::chrono::duration<double> wall = std::chrono::steady_clock::now() - started;
+            std::cout << fmt::format("Pipeline: {} file(s) in {:.3f}s;", parsers.getItemCount(), wall.count());
+            for (const auto* stage : { &readers, &parsers }) {
+                std::cout << fmt::format(" {} {}x {:.0f}% busy,", stage->getName(), stage->getThreadCount(),
+                    stage->utilisation(wall.count()) * 100);
+            }
+            std::cout << fmt::format(" {} {}x {:.0f}% busy\n", writers.getName(), writers.getThreadCount(),
+                writers.utilisation(wall.count()) * 100);
+        }
+    };
+
+    auto report_stats = [&]() {
+        if (manifest) manifest->flush();
+        if (timeline && !timeline->write(timelinePath)) {
+            std::cerr << "Warning: could not write --trace to " << timelinePath << "\n";
+        }
+        if (schemaProfile) {
+            schemaProfile->printReport(std::cout, 20);
+            if (!foldedPath.empty() && !schemaProfile->writeFolded(foldedPath)) {
+                std::cerr << "Warning: could not write --profile-schema to " << foldedPath << "\n";
+            }
+        }
+        if (!runStats) return;
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - runStarted;
+        runStats->printTable(std::cout, wall.count());
+        if (!statsPath.empty() && !runStats->writeJson(statsPath, wall.count())) {
+            std::cerr << "Warning: could not write --stats to " << statsPath << "\n";
+        }
+    };
+
+    // --watch reports every batch on its own, so nothing grows with uptime.
+    auto reset_stats = [&]() {
+        if (runStats) {
+            runStats = std::make_unique<RunStats>();
+            if (trackAllocs) runStats->showAllocations();
+        }
+        if (timeline) timeline = std::make_unique<Timeline>();
+        if (schemaProfile) schemaProfile = std::make_unique<SchemaProfile>();
+    };
+
+    auto schedule_batch = [&](const std::function<void(const FileSink&)>& produce) {
+        if (!largestFirst) {
+            dispatch_batch(produce);
+            return;
+        }
+
+        // Sizes are looked up on the producer's threads, in parallel with the walk.
+        std::mutex filesMutex;
+        std::vector<ScheduledFile> files;
+        produce([&](fs::path file) {
+            std::error_code ec;
+            ScheduledFile scheduled{ std::move(file) };
+            scheduled.size = fs::file_size(scheduled.path, ec);
+            if (ec) scheduled.size = 0;
+            scheduled.type = catalog.findFileType(scheduled.path.string());
+            std::lock_guard<std::mutex> lock(filesMutex);
+            files.push_back(std::move(scheduled));
+        });
+        order_largest_first(files);
+        dispatch_batch([&](const FileSink& submit) {
+            for (auto& file : files) submit(std::move(file.path));
+        });
+    };
+
+    auto run_batch = [&](const std::function<void(const FileSink&)>& produce) {
+        if (!showProgress) {
+            schedule_batch(produce);
+            return;
+        }
+        progress = std::make_unique<ProgressReporter>(static_cast<unsigned>(threadCount));
+        schedule_batch([&](const FileSink& submit) {
+            produce([&](fs::path file) {
+                progress->addQueued();
+                submit(std::move(file));
+            });
+            progress->setComplete();
+        });
+        progress->finish();
+        progress.reset();
+    };
+
+    if (listMode) {
+        std::FILE* list = stdin;
+        if (filesFrom != "-") {
+            list = std::fopen(filesFrom.c_str(), "rb");
+            if (!list) {
+                std::cerr << "Error: cannot open file list: " << filesFrom << "\n";
+                return 1;
+            }
+        }
+#ifdef _WIN32
+        else {
+            _setmode(_fileno(stdin), _O_BINARY);
+        }
+#endif
+        run_batch([&](const FileSink& submit) {
+            read_path_list(list, nullSeparated, [&](fs::path file) {
+                if (!is_package(file) && !has_any_extension(file, extFilter)) return;
+                if (!fs::is_regular_file(file)) {
+                    add_input_failure(file);
+                    std::cerr << "Not a file: " << file << "\n";
+                    return;
+                }
+                submit(std::move(file));
+            });
+        });
+        if (list != stdin) std::fclose(list);
+    } else if (watchMode) {
+        if (!fs::is_directory(in)) {
+            std::cerr << "Error: --watch needs a directory\n";
+            return 1;
+        }
+        DirectoryWatcher watcher;
+        std::string error;
+        if (!watcher.start(in, error)) {
+            std::cerr << "Error: --watch: " << error << "\n";
+            return 1;
+        }
+
+        WorkerPool<fs::path> pool(threadCount, threadCount * 4, [&](fs::path& file) { process_path(file); });
+        if (!silentMode) std::cout << "Watching " << in << " with " << threadCount << " worker(s)" << std::endl;
+
+        while (true) {
+            std::vector<fs::path> changed = watcher.nextBatch(std::chrono::milliseconds(watchDelay));
+            if (changed.empty()) {
+                std::cerr << "Error: --watch: lost the inotify watch\n";
+                return 1;
+            }
+
+            // Our own exports land in the same tree when no --output is given;
+            // only inputs the catalog knows about are queued.
+            size_t queued = 0;
+            size_t failedBefore = failedFiles.size();
+            auto started = std::chrono::steady_clock::now();
+            runStarted = started;
+            for (auto& file : changed) {
+                if (!is_package(file)) {
+                    if (!has_any_extension(file, extFilter) || !catalog.findFileType(file.string())) continue;
+                }
+                pool.submit(file);
+                queued++;
+            }
+            pool.wait();
+            if (queued == 0) continue;
+
+            if (exportCache && !exportCache->save()) {
+                std::cerr << "Warning: could not write the incremental cache manifest\n";
+            }
+            if (currentCatalog && !nextCatalog.save((stateDir / ".recap_catalog").string())) {
+                std::cerr << "Warning: could not write the catalog snapshot\n";
+            }
+            if (!silentMode) {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+                std::cout << fmt::format("Re-exported {} changed file(s), {} failed, in {:.3f}s\n",
+                    queued, failedFiles.size() - failedBefore, elapsed.count()) << std::flush;
+            }
+            report_stats();
+            reset_stats();
+        }
+    } else if (inputPath == "-") {
+        if (stdinName.empty()) {
+            std::cerr << "Error: reading from stdin requires --stdin-name\n";
+            return 1;
+        }
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        InputItem item;
+        item.path = stdinName;
+        item.reader = [](char* dst, size_t capacity) {
+            return std::fread(dst, 1, capacity, stdin);
+        };
+        process_one(item);
+    } else if (fs::is_regular_file(in)) {
+        process_path(in);
     } else if (fs::is_directory(in)) {
         if (recursiveMode) {
-            for (auto it = fs::recursive_directory_iterator(in); it != fs::recursive_directory_iterator(); ++it) {
-                if (!it->is_regular_file()) continue;
-                const fs::path& p = it->path();
-                if (!has_any_extension(p, extFilter)) continue;
-                process_one(p);
-            }
+            // Files are parsed while the rest of the tree is still being read.
+            run_batch([&](const FileSink& submit) {
+                TreeWalker walker(threadCount);
+                Timeline::Scope walkSpan(timeline.get(), "phase", "walk", in.string());
+                walker.walk(in, [&](const fs::path& p) { return is_package(p) || has_any_extension(p, extFilter); }, submit);
+            });
         } else {
             for (auto& de : fs::directory_iterator(in)) {
                 if (!de.is_regular_file()) continue;
                 const fs::path& p = de.path();
-                process_one(p);
+                process_path(p);
             }
         }
     } else {
         std::cerr << "Error: path type not supported\n";
-        if (logFile.is_open()) {
-            std::cout.rdbuf(coutOrig);
-            std::cerr.rdbuf(cerrOrig);
-        }
         return 1;
     }
 
-    if (logFile.is_open()) {
-        std::cout.rdbuf(coutOrig);
-        std::cerr.rdbuf(cerrOrig);
+    if (exportCache && !exportCache->save()) {
+        std::cerr << "Warning: could not write the incremental cache manifest\n";
+    }
+    if (currentCatalog && !nextCatalog.save((stateDir / ".recap_catalog").string())) {
+        std::cerr << "Warning: could not write the catalog snapshot\n";
+    }
+    if (!silentMode && unchangedFiles > 0) {
+        std::cout << "Skipped " << unchangedFiles << " unchanged file(s)\n";
+    }
+    if (!silentMode && duplicateFiles > 0) {
+        std::cout << fmt::format("Reused the output of {} duplicate file(s), saving {:.3f}s of parsing and export\n",
+            duplicateFiles, dedupSavedSeconds);
     }
+    report_stats();
 
     return failedFiles.empty() ? 0 : 1;
 }
@@ -0,0 +1,47 @@
+#include "manifest.h"
+#include "json_escape.h"
+#include <fmt/format.h>
+
+namespace {
+    void appendString(std::string& out, const char* key, const std::string& value) {
+        out += fmt::format(", \"{}\": \"", key);
+        appendJsonEscaped(out, value);
+        out += '"';
+    }
+}
+
+ResultManifest::ResultManifest(const std::string& path) : out(std::fopen(path.c_str(), "wb")) {
+}
+
+ResultManifest::~ResultManifest() {
+    if (out) std::fclose(out);
+}
+
+void ResultManifest::write(const ManifestRecord& record) {
+    if (!out) return;
+
+    std::string line = "{\"input\": \"";
+    appendJsonEscaped(line, record.input);
+    line += fmt::format("\", \"input_bytes\": {}", record.inputBytes);
+    if (record.inputHashed) line += fmt::format(", \"input_xxh64\": \"{:016x}\"", record.inputHash);
+    appendString(line, "type", record.type);
+    appendString(line, "version", record.version);
+    appendString(line, "status", record.status);
+    if (!record.output.empty()) {
+        appendString(line, "output", record.output);
+        if (record.outputHashed) {
+            line += fmt::format(", \"output_bytes\": {}, \"output_xxh64\": \"{:016x}\"", record.outputBytes, record.outputHash);
+        }
+    }
+    if (!record.sameAs.empty()) appendString(line, "same_as", record.sameAs);
+    line += fmt::format(", \"decode_s\": {:.6f}, \"format_s\": {:.6f}, \"write_s\": {:.6f}}}\n",
+        record.decodeSeconds, record.formatSeconds, record.writeSeconds);
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::fwrite(line.data(), 1, line.size(), out);
+}
+
+void ResultManifest::flush() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    if (out) std::fflush(out);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// The outcome of one input, as one line of the --manifest file.
+struct ManifestRecord {
+    std::string input;
+    uint64_t inputBytes = 0;
+    uint64_t inputHash = 0;
+    bool inputHashed = false;
+    std::string type;
+    std::string version;
+
+    // ok, failed, unchanged (skipped by --incremental or --catalog-diff) or
+    // duplicate (output copied from sameAs by --dedup).
+    std::string status = "failed";
+    std::string output;
+    uint64_t outputBytes = 0;
+    uint64_t outputHash = 0;
+    bool outputHashed = false;
+    std::string sameAs;
+
+    void setOutput(std::string path, uint64_t bytes, uint64_t hash) {
+        output = std::move(path);
+        outputBytes = bytes;
+        outputHash = hash;
+        outputHashed = true;
+    }
+
+    double decodeSeconds = 0;
+    double formatSeconds = 0;
+    double writeSeconds = 0;
+};
+
+// --manifest: a JSON Lines file with one record per input, so downstream jobs
+// can tell what a run produced without scanning and hashing the output tree.
+// Hashes are XXH64 of the input and output bytes. Records are appended as
+// files finish, in completion order.
+class ResultManifest {
+private:
+    std::FILE* out = nullptr;
+    std::mutex writeMutex;
+
+public:
+    explicit ResultManifest(const std::string& path);
+    ResultManifest(const ResultManifest&) = delete;
+    ResultManifest& operator=(const ResultManifest&) = delete;
+    ~ResultManifest();
+
+    bool isOpen() const {
+        return out != nullptr;
+    }
+
+    void write(const ManifestRecord& record);
+    void flush();
+
+    // Writes its record when it goes out of scope, so every way out of a
+    // file is recorded; a no-op without a manifest. release() hands the
+    // record to whoever finishes the file instead.
+    class Entry {
+    private:
+        ResultManifest* manifest;
+
+    public:
+        ManifestRecord record;
+
+        explicit Entry(ResultManifest* manifest) : manifest(manifest) {
+        }
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        ~Entry() {
+            if (manifest) manifest->write(record);
+        }
+
+        bool active() const {
+            return manifest != nullptr;
+        }
+
+        ManifestRecord release() {
+            manifest = nullptr;
+            return std::move(record);
+        }
+    };
+};
@@ -0,0 +1,353 @@
+#include "package.h"
+#include <fstream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (data && mappingHandle) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+    mapped = false;
+#endif
+    std::vector<char>().swap(fallback);
+    data = nullptr;
+    size = 0;
+}
+
+bool MappedFile::open(const std::string& filepath) {
+    close();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle != INVALID_HANDLE_VALUE) {
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(handle, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (view) {
+                    fileHandle = handle;
+                    mappingHandle = mapping;
+                    data = static_cast<const char*>(view);
+                    size = static_cast<size_t>(fileSize.QuadPart);
+                    return true;
+                }
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(handle);
+    }
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                ::close(fd);
+                mapped = true;
+                data = static_cast<const char*>(view);
+                size = static_cast<size_t>(st.st_size);
+                return true;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+
+    std::ifstream in(filepath, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    std::streamoff fileSize = in.tellg();
+    in.seekg(0);
+    fallback.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+    if (!fallback.empty() && !in.read(fallback.data(), fallback.size())) {
+        return false;
+    }
+    data = fallback.data();
+    size = fallback.size();
+    return true;
+}
+
+bool readWholeFile(const std::string& filepath, std::vector<char>& out) {
+    out.clear();
+#ifndef _WIN32
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    out.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = ::pread(fd, out.data() + done, out.size() - done, static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    out.resize(done);
+    return done == static_cast<size_t>(st.st_size);
+#else
+    std::ifstream in(filepath, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    std::streamoff fileSize = in.tellg();
+    in.seekg(0);
+    out.resize(fileSize > 0 ? static_cast<size_t>(fileSize) : 0);
+    return out.empty() || static_cast<bool>(in.read(out.data(), out.size()));
+#endif
+}
+
+uint32_t packageHash(std::string_view name) {
+    uint32_t hash = 0x811C9DC5;
+    for (char c : name) {
+        hash *= 0x01000193;
+        hash ^= static_cast<uint32_t>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return hash;
+}
+
+bool decompressRefPack(const char* src, size_t srcSize, size_t expectedSize, std::vector<char>& out) {
+    const auto* in = reinterpret_cast<const uint8_t*>(src);
+    if (srcSize < 5 || in[1] != 0xFB) {
+        return false;
+    }
+
+    const size_t sizeBytes = (in[0] & 0x80) ? 4 : 3;
+    size_t pos = 2;
+    if (in[0] & 0x01) {
+        pos += sizeBytes;
+    }
+    if (pos + sizeBytes > srcSize) {
+        return false;
+    }
+
+    size_t outSize = 0;
+    for (size_t i = 0; i < sizeBytes; i++) {
+        outSize = (outSize << 8) | in[pos++];
+    }
+    if (outSize != expectedSize || outSize > MAX_REFPACK_SIZE) {
+        return false;
+    }
+
+    out.resize(outSize);
+    size_t outPos = 0;
+
+    while (pos < srcSize) {
+        const uint8_t c0 = in[pos++];
+        size_t numPlain = 0;
+        size_t numCopy = 0;
+        size_t copyOffset = 0;
+        bool last = false;
+
+        if (c0 < 0x80) {
+            if (pos + 1 > srcSize) return false;
+            const uint8_t c1 = in[pos++];
+            numPlain = c0 & 0x03;
+            numCopy = ((c0 & 0x1C) >> 2) + 3;
+            copyOffset = ((c0 & 0x60) << 3) + c1 + 1;
+        }
+        else if (c0 < 0xC0) {
+            if (pos + 2 > srcSize) return false;
+            const uint8_t c1 = in[pos++];
+            const uint8_t c2 = in[pos++];
+            numPlain = (c1 >> 6) & 0x03;
+            numCopy = (c0 & 0x3F) + 4;
+            copyOffset = ((c1 & 0x3F) << 8) + c2 + 1;
+        }
+        else if (c0 < 0xE0) {
+            if (pos + 3 > srcSize) return false;
+            const uint8_t c1 = in[pos++];
+            const uint8_t c2 = in[pos++];
+            const uint8_t c3 = in[pos++];
+            numPlain = c0 & 0x03;
+            numCopy = ((c0 & 0x0C) << 6) + c3 + 5;
+            copyOffset = ((c0 & 0x10) << 12) + (c1 << 8) + c2 + 1;
+        }
+        else if (c0 < 0xFC) {
+            numPlain = ((c0 & 0x1F) << 2) + 4;
+        }
+        else {
+            numPlain = c0 & 0x03;
+            last = true;
+        }
+
+        if (pos + numPlain > srcSize || outPos + numPlain > outSize) {
+            return false;
+        }
+        std::memcpy(out.data() + outPos, in + pos, numPlain);
+        pos += numPlain;
+        outPos += numPlain;
+
+        if (numCopy > 0) {
+            if (copyOffset > outPos || outPos + numCopy > outSize) {
+                return false;
+            }
+            // Byte by byte: the source may overlap the bytes being written.
+            for (size_t i = 0; i < numCopy; i++, outPos++) {
+                out[outPos] = out[outPos - copyOffset];
+            }
+        }
+
+        if (last) {
+            break;
+        }
+    }
+
+    return outPos == outSize;
+}
+
+namespace {
+    constexpr size_t HEADER_SIZE = 96;
+
+    uint32_t readU32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint16_t readU16(const char* p) {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+bool DbpfPackage::open(const std::string& filepath, std::string& error) {
+    entries.clear();
+    if (!file.open(filepath)) {
+        error = "cannot open package";
+        return false;
+    }
+
+    const char* data = file.getData();
+    const size_t size = file.getSize();
+    if (size < HEADER_SIZE || std::memcmp(data, "DBPF", 4) != 0) {
+        error = "not a DBPF package";
+        return false;
+    }
+
+    const uint32_t majorVersion = readU32(data + 4);
+    if (majorVersion != 2 && majorVersion != 3) {
+        error = "unsupported DBPF version " + std::to_string(majorVersion);
+        return false;
+    }
+
+    const uint32_t indexCount = readU32(data + 0x24);
+    const uint32_t indexSize = readU32(data + 0x2C);
+    const uint64_t indexOffset = readU32(data + 0x40);
+    if (indexOffset + indexSize > size || indexSize < 4) {
+        error = "index lies outside the package";
+        return false;
+    }
+
+    const char* p = data + indexOffset;
+    const char* end = p + indexSize;
+    const uint32_t indexType = readU32(p);
+    p += 4;
+
+    uint32_t constType = 0;
+    uint32_t constGroup = 0;
+    const size_t constFields = ((indexType & 1) ? 1 : 0) + ((indexType & 2) ? 1 : 0) + ((indexType & 4) ? 1 : 0);
+    if (p + constFields * 4 > end) {
+        error = "truncated index";
+        return false;
+    }
+    if (indexType & 1) { constType = readU32(p); p += 4; }
+    if (indexType & 2) { constGroup = readU32(p); p += 4; }
+    if (indexType & 4) { p += 4; }
+
+    const size_t entrySize = 20 + (3 - constFields) * 4;
+    // The count comes from the header; no more entries than the index holds.
+    entries.reserve(std::min<size_t>(indexCount, static_cast<size_t>(end - p) / entrySize));
+    for (uint32_t i = 0; i < indexCount; i++) {
+        if (p + entrySize > end) {
+            error = "truncated index";
+            return false;
+        }
+
+        PackageEntry entry;
+        entry.typeId = constType;
+        entry.groupId = constGroup;
+        if (!(indexType & 1)) { entry.typeId = readU32(p); p += 4; }
+        if (!(indexType & 2)) { entry.groupId = readU32(p); p += 4; }
+        if (!(indexType & 4)) { p += 4; }
+        entry.instanceId = readU32(p);
+        entry.offset = readU32(p + 4);
+        entry.diskSize = readU32(p + 8) & 0x7FFFFFFF;
+        entry.memorySize = readU32(p + 12);
+        entry.compressed = readU16(p + 16) == 0xFFFF;
+        p += 20;
+
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+bool DbpfPackage::readEntry(const PackageEntry& entry, std::vector<char>& scratch,
+    std::string_view& bytes, std::string& error) const {
+    if (entry.offset + entry.diskSize > file.getSize()) {
+        error = "entry lies outside the package";
+        return false;
+    }
+
+    const char* src = file.getData() + entry.offset;
+    if (!entry.compressed) {
+        bytes = std::string_view(src, entry.diskSize);
+        return true;
+    }
+
+    if (!decompressRefPack(src, entry.diskSize, entry.memorySize, scratch)) {
+        error = "corrupt RefPack data";
+        return false;
+    }
+    bytes = std::string_view(scratch.data(), scratch.size());
+    return true;
+}
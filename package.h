@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Read-only view of a whole file. Uses a memory mapping where the platform
+// provides one and falls back to reading the file into memory otherwise.
+class MappedFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<char> fallback;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    bool mapped = false;
+#endif
+
+    void close();
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const std::string& filepath);
+
+    const char* getData() const {
+        return data;
+    }
+
+    size_t getSize() const {
+        return size;
+    }
+};
+
+// Reads a whole file into out in one sequential pass, asking the kernel to
+// read ahead aggressively. Used by the pipeline's reader threads, so the
+// parse threads never wait on the disk.
+bool readWholeFile(const std::string& filepath, std::vector<char>& out);
+
+struct PackageEntry {
+    uint32_t typeId = 0;
+    uint32_t groupId = 0;
+    uint32_t instanceId = 0;
+    uint64_t offset = 0;
+    uint32_t diskSize = 0;
+    uint32_t memorySize = 0;
+    bool compressed = false;
+};
+
+// Spore-style FNV-1 hash of a lowercase name, as used for DBPF type, group and
+// instance ids.
+uint32_t packageHash(std::string_view name);
+
+// Largest expanded entry accepted. Assets are far smaller, so a bigger size
+// in a stream header means the entry is corrupt.
+constexpr size_t MAX_REFPACK_SIZE = 256 * 1024 * 1024;
+
+// Expands a RefPack (QFS) stream as used by compressed DBPF entries. Fails
+// unless the stream expands to exactly expectedSize bytes.
+bool decompressRefPack(const char* src, size_t srcSize, size_t expectedSize, std::vector<char>& out);
+
+// DBPF 2.x/3.x container (the 32-bit index layout used by Spore and Darkspore).
+class DbpfPackage {
+private:
+    MappedFile file;
+    std::vector<PackageEntry> entries;
+
+public:
+    bool open(const std::string& filepath, std::string& error);
+
+    const std::vector<PackageEntry>& getEntries() const {
+        return entries;
+    }
+
+    // Returns a view into the mapped archive for stored entries; compressed
+    // entries are expanded into scratch, which the view then points into.
+    bool readEntry(const PackageEntry& entry, std::vector<char>& scratch,
+        std::string_view& bytes, std::string& error) const;
+};
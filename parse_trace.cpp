@@ -0,0 +1,306 @@
+#include "parse_trace.h"
+#include <iterator>
+
+namespace {
+    constexpr char TRACE_MAGIC[4] = { 'R', 'C', 'P', 'T' };
+    constexpr char CHUNK_MAGIC[4] = { 'C', 'H', 'N', 'K' };
+    constexpr uint32_t TRACE_VERSION = 1;
+
+    template<typename T>
+    void writeValue(std::ofstream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool readValue(std::ifstream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    // Bytes between the read position and end, so counts from a corrupt log
+    // are rejected before anything is sized by them.
+    uint64_t bytesLeft(std::ifstream& in, uint64_t end) {
+        std::streamoff pos = in.tellg();
+        return pos < 0 || static_cast<uint64_t>(pos) > end ? 0 : end - static_cast<uint64_t>(pos);
+    }
+
+    bool readText(std::ifstream& in, uint64_t end, std::string& text) {
+        uint32_t length;
+        if (!readValue(in, length) || length > bytesLeft(in, end)) {
+            return false;
+        }
+        text.resize(length);
+        return length == 0 || static_cast<bool>(in.read(text.data(), length));
+    }
+}
+
+void renderTraceRecord(fmt::memory_buffer& out, const TraceRecord& record,
+    std::string_view name, std::string_view text0, std::string_view text1, bool withOffsets) {
+    auto it = std::back_inserter(out);
+    if (withOffsets) {
+        fmt::format_to(it, "({}, {}) ", record.primaryOffset, record.secondaryOffset);
+    }
+    fmt::format_to(it, "{:{}}", "", record.depth * 4);
+
+    const uint64_t v0 = record.value[0];
+    const uint64_t v1 = record.value[1];
+
+    switch (static_cast<TraceOp>(record.op)) {
+    case TraceOp::Struct:
+        fmt::format_to(it, "parse_struct({})", name);
+        break;
+    case TraceOp::StructElement:
+        fmt::format_to(it, "parse_struct({}, [{}])", name, v0);
+        break;
+    case TraceOp::Array:
+        fmt::format_to(it, "parse_member_array({}, {})", name, v0);
+        break;
+    case TraceOp::Bool:
+        fmt::format_to(it, "parse_member_bool({}, {})", name, v0 != 0);
+        break;
+    case TraceOp::Int:
+        fmt::format_to(it, "parse_member_int({}, {})", name, static_cast<int32_t>(v0));
+        break;
+    case TraceOp::Float:
+        fmt::format_to(it, "parse_member_float({}, {:.5f})", name, traceFloat(v0));
+        break;
+    case TraceOp::Guid:
+        fmt::format_to(it, "parse_member_guid({}, {:08x}-{:04x}-{:04x}-{:04x}-{:012x})", name,
+            static_cast<uint32_t>(v0), (v0 >> 32) & 0xFFFF, (v0 >> 48) & 0xFFFF,
+            (v1 >> 48) & 0xFFFF, v1 & 0xFFFFFFFFFFFFULL);
+        break;
+    case TraceOp::Vector2:
+        fmt::format_to(it, "parse_member_cSPVector2({}, x: {:.5f}, y: {:.5f})", name,
+            traceFloat(v0), traceFloat(v0 >> 32));
+        break;
+    case TraceOp::Vector3:
+        fmt::format_to(it, "parse_member_cSPVector3({}, x: {:.5f}, y: {:.5f}, z: {:.5f})", name,
+            traceFloat(v0), traceFloat(v0 >> 32), traceFloat(v1));
+        break;
+    case TraceOp::Vector4:
+        fmt::format_to(it, "parse_member_cSPVector4({}, w: {:.5f}, x: {:.5f}, y: {:.5f}, z: {:.5f})", name,
+            traceFloat(v0), traceFloat(v0 >> 32), traceFloat(v1), traceFloat(v1 >> 32));
+        break;
+    case TraceOp::Key:
+        fmt::format_to(it, "parse_member_key({}, {})", name, text0);
+        break;
+    case TraceOp::KeyAsset:
+        fmt::format_to(it, "parse_member_cKeyAsset({}, {})", name, text0);
+        break;
+    case TraceOp::LocalizedString:
+        fmt::format_to(it, "parse_member_cLocalizedAssetString({}, {})", name, text0);
+        break;
+    case TraceOp::LocalizedStringId:
+        fmt::format_to(it, "parse_member_cLocalizedAssetString({}, {}, {})", name, text0, text1);
+        break;
+    case TraceOp::Asset:
+        fmt::format_to(it, "parse_member_asset({}, {})", name, text0);
+        break;
+    case TraceOp::CharPtr:
+        fmt::format_to(it, "parse_member_char*({}, {})", name, text0);
+        break;
+    case TraceOp::Char:
+        fmt::format_to(it, "parse_member_char({}, {})", name, text0);
+        break;
+    case TraceOp::Enum:
+        fmt::format_to(it, "parse_member_enum({}, {})", name, static_cast<uint32_t>(v0));
+        break;
+    case TraceOp::UInt8:
+        fmt::format_to(it, "parse_member_uint8_t({}, {})", name, static_cast<uint8_t>(v0));
+        break;
+    case TraceOp::UInt16:
+        fmt::format_to(it, "parse_member_uint16_t({}, {})", name, static_cast<uint16_t>(v0));
+        break;
+    case TraceOp::UInt32:
+        fmt::format_to(it, "parse_member_uint32_t({}, {})", name, static_cast<uint32_t>(v0));
+        break;
+    case TraceOp::UInt64:
+        fmt::format_to(it, "parse_member_uint64_t({}, 0x{:X})", name, v0);
+        break;
+    case TraceOp::Int64:
+        fmt::format_to(it, "parse_member_int64_t({}, 0x{:X})", name, static_cast<int64_t>(v0));
+        break;
+    case TraceOp::Nullable:
+        fmt::format_to(it, "parse_member_nullable({})", text0);
+        break;
+    case TraceOp::NullableNamed:
+        fmt::format_to(it, "parse_member_nullable({}, {})", name, text0);
+        break;
+    case TraceOp::StructMember:
+        fmt::format_to(it, "parse_member_struct({})", text0);
+        break;
+    case TraceOp::StructMemberNamed:
+        fmt::format_to(it, "parse_member_struct({}, {})", name, text0);
+        break;
+    default:
+        fmt::format_to(it, "parse_member_unknown({}, unknown)", name);
+        break;
+    }
+    out.push_back('\n');
+}
+
+ParseTraceBuffer::ParseTraceBuffer(ParseTraceLog& log, const std::string& path)
+    : log(log), path(path) {
+}
+
+ParseTraceBuffer::~ParseTraceBuffer() {
+    flush();
+}
+
+uint32_t ParseTraceBuffer::intern(std::string_view text) {
+    auto it = stringIds.find(text);
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.emplace_back(text);
+    stringIds.emplace(strings.back(), id);
+    return id;
+}
+
+void ParseTraceBuffer::append(TraceRecord record, std::string_view name, std::string_view text0, std::string_view text1) {
+    const bool full = records.size() >= log.getCapacity();
+    if (full && !log.isRingMode()) {
+        flush();
+    }
+
+    record.nameId = intern(name);
+    if (traceOpHasText(static_cast<TraceOp>(record.op))) {
+        record.value[0] = intern(text0);
+        record.value[1] = intern(text1);
+    }
+
+    if (full && log.isRingMode()) {
+        records[ringHead] = record;
+        ringHead = (ringHead + 1) % records.size();
+        droppedRecords++;
+        return;
+    }
+
+    records.push_back(record);
+}
+
+void ParseTraceBuffer::flush() {
+    if (records.empty()) {
+        return;
+    }
+
+    log.writeChunk(path, strings,
+        records.data() + ringHead, records.size() - ringHead,
+        records.data(), ringHead,
+        droppedRecords);
+
+    records.clear();
+    ringHead = 0;
+    droppedRecords = 0;
+    stringIds.clear();
+    strings.clear();
+}
+
+ParseTraceLog::ParseTraceLog(const std::string& filepath, size_t capacity, bool ringMode)
+    : out(filepath, std::ios::binary | std::ios::trunc), capacity(capacity > 0 ? capacity : 1), ringMode(ringMode) {
+    if (out.is_open()) {
+        out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+        writeValue(out, TRACE_VERSION);
+    }
+}
+
+void ParseTraceLog::writeChunk(const std::string& path, const std::deque<std::string>& strings,
+    const TraceRecord* first, size_t firstCount, const TraceRecord* second, size_t secondCount,
+    uint64_t droppedRecords) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!out.is_open()) {
+        return;
+    }
+
+    out.write(CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    writeValue(out, static_cast<uint32_t>(path.size()));
+    out.write(path.data(), path.size());
+    writeValue(out, droppedRecords);
+
+    writeValue(out, static_cast<uint32_t>(strings.size()));
+    for (const auto& text : strings) {
+        writeValue(out, static_cast<uint32_t>(text.size()));
+        out.write(text.data(), text.size());
+    }
+
+    writeValue(out, static_cast<uint32_t>(firstCount + secondCount));
+    out.write(reinterpret_cast<const char*>(first), firstCount * sizeof(TraceRecord));
+    out.write(reinterpret_cast<const char*>(second), secondCount * sizeof(TraceRecord));
+}
+
+bool ParseTraceLog::decode(const std::string& filepath, std::FILE* output, bool withOffsets) {
+    std::ifstream in(filepath, std::ios::binary | std::ios::ate);
+    const std::streamoff end = in.tellg();
+    if (end < 0) {
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(end);
+    in.seekg(0);
+    char magic[4];
+    uint32_t version;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(in, version) || version != TRACE_VERSION) {
+        return false;
+    }
+
+    std::string lastPath;
+    std::vector<std::string> strings;
+    std::vector<TraceRecord> records;
+    fmt::memory_buffer buffer;
+
+    while (in.read(magic, sizeof(magic))) {
+        if (std::memcmp(magic, CHUNK_MAGIC, sizeof(magic)) != 0) {
+            return false;
+        }
+
+        std::string path;
+        uint64_t droppedRecords;
+        uint32_t stringCount;
+        if (!readText(in, fileSize, path) || !readValue(in, droppedRecords) || !readValue(in, stringCount) ||
+            stringCount > bytesLeft(in, fileSize) / sizeof(uint32_t)) {
+            return false;
+        }
+
+        strings.resize(stringCount);
+        for (auto& text : strings) {
+            if (!readText(in, fileSize, text)) {
+                return false;
+            }
+        }
+
+        uint32_t recordCount;
+        if (!readValue(in, recordCount) || recordCount > bytesLeft(in, fileSize) / sizeof(TraceRecord)) {
+            return false;
+        }
+        records.resize(recordCount);
+        if (!in.read(reinterpret_cast<char*>(records.data()), recordCount * sizeof(TraceRecord))) {
+            return false;
+        }
+
+        if (path != lastPath) {
+            fmt::print(output, "# {}\n", path);
+            lastPath = path;
+        }
+        if (droppedRecords > 0) {
+            fmt::print(output, "# ... {} earlier records dropped\n", droppedRecords);
+        }
+
+        auto lookup = [&](uint64_t id) -> std::string_view {
+            return id < strings.size() ? std::string_view(strings[id]) : std::string_view();
+        };
+
+        for (const auto& record : records) {
+            std::string_view text0;
+            std::string_view text1;
+            if (traceOpHasText(static_cast<TraceOp>(record.op))) {
+                text0 = lookup(record.value[0]);
+                text1 = lookup(record.value[1]);
+            }
+            buffer.clear();
+            renderTraceRecord(buffer, record, lookup(record.nameId), text0, text1, withOffsets);
+            std::fwrite(buffer.data(), 1, buffer.size(), output);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+
+enum class TraceOp : uint8_t {
+    Struct,
+    StructElement,
+    Array,
+    Bool,
+    Int,
+    Float,
+    Guid,
+    Vector2,
+    Vector3,
+    Vector4,
+    Key,
+    KeyAsset,
+    LocalizedString,
+    LocalizedStringId,
+    Asset,
+    CharPtr,
+    Char,
+    Enum,
+    UInt8,
+    UInt16,
+    UInt32,
+    UInt64,
+    Int64,
+    Nullable,
+    NullableNamed,
+    StructMember,
+    StructMemberNamed,
+    Unknown
+};
+
+// One parse step. Strings are stored as ids into the owning chunk's string
+// table; scalar values keep their raw bits so rendering can happen offline.
+struct TraceRecord {
+    uint32_t primaryOffset;
+    uint32_t secondaryOffset;
+    uint32_t nameId;
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t depth;
+    uint64_t value[2];
+};
+static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay a fixed 32 bytes");
+
+inline uint64_t traceBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline uint64_t traceBits(float low, float high) {
+    return traceBits(low) | (traceBits(high) << 32);
+}
+
+inline float traceFloat(uint64_t bits) {
+    uint32_t low = static_cast<uint32_t>(bits);
+    float value;
+    std::memcpy(&value, &low, sizeof(value));
+    return value;
+}
+
+// Ops whose value slots hold string ids rather than raw bits.
+inline bool traceOpHasText(TraceOp op) {
+    switch (op) {
+    case TraceOp::Key:
+    case TraceOp::KeyAsset:
+    case TraceOp::LocalizedString:
+    case TraceOp::LocalizedStringId:
+    case TraceOp::Asset:
+    case TraceOp::CharPtr:
+    case TraceOp::Char:
+    case TraceOp::Nullable:
+    case TraceOp::NullableNamed:
+    case TraceOp::StructMember:
+    case TraceOp::StructMemberNamed:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Renders a record exactly like the live --debug/verbose output, including the
+// trailing newline. Shared by Parser and the offline decoder.
+void renderTraceRecord(fmt::memory_buffer& out, const TraceRecord& record,
+    std::string_view name, std::string_view text0, std::string_view text1, bool withOffsets);
+
+class ParseTraceLog;
+
+// Records of a single parse, buffered in memory and handed to the log as
+// self-contained chunks. In ring mode the oldest records are overwritten
+// instead of flushed, keeping only the tail leading up to a bad offset.
+class ParseTraceBuffer {
+private:
+    ParseTraceLog& log;
+    std::string path;
+    std::vector<TraceRecord> records;
+    size_t ringHead = 0;
+    uint64_t droppedRecords = 0;
+
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, uint32_t> stringIds;
+
+    uint32_t intern(std::string_view text);
+
+public:
+    ParseTraceBuffer(ParseTraceLog& log, const std::string& path);
+    ~ParseTraceBuffer();
+
+    void append(TraceRecord record, std::string_view name, std::string_view text0, std::string_view text1);
+    void flush();
+};
+
+// Binary trace file shared by every parse of a run.
+class ParseTraceLog {
+private:
+    std::ofstream out;
+    std::mutex mutex;
+    size_t capacity;
+    bool ringMode;
+
+    friend class ParseTraceBuffer;
+    void writeChunk(const std::string& path, const std::deque<std::string>& strings,
+        const TraceRecord* first, size_t firstCount, const TraceRecord* second, size_t secondCount,
+        uint64_t droppedRecords);
+
+public:
+    ParseTraceLog(const std::string& filepath, size_t capacity = 65536, bool ringMode = false);
+
+    bool isOpen() const {
+        return out.is_open();
+    }
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    bool isRingMode() const {
+        return ringMode;
+    }
+
+    // Renders a trace file back to text; returns false if it is not a trace log.
+    static bool decode(const std::string& filepath, std::FILE* output, bool withOffsets);
+};
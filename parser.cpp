@@ -1,5 +1,7 @@
 ﻿#include "catalog.h"
 #include "exporter.h"
+#include "projection.h"
+#include "timeline.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
@@ -13,23 +15,44 @@ namespace fs = std::filesystem;
 namespace fs = std::experimental::filesystem;
 #endif
 
+const FileTypeInfo* Parser::resolveFileType() const {
+    return catalog.findFileType(filename);
+}
+
 bool Parser::parse() {
-    fileStream.open(filename, std::ios::binary);
-    if (!fileStream) {
+    const FileTypeInfo* fileType = resolveFileType();
+    if (!fileType) {
+        return false;
+    }
+
+    if (!offsetManager.load(filename)) {
         return false;
     }
 
-    std::string extension = fs::path(filename).extension().string();
-    const FileTypeInfo* fileType = catalog.getFileType(extension);
+    return parseInput(fileType);
+}
 
+bool Parser::parse(const char* data, size_t size) {
+    const FileTypeInfo* fileType = resolveFileType();
     if (!fileType) {
-        fileType = catalog.getFileTypeByName(filename);
+        return false;
     }
 
+    offsetManager.attach(data, size);
+    return parseInput(fileType);
+}
+
+bool Parser::parse(ChunkReader reader) {
+    const FileTypeInfo* fileType = resolveFileType();
     if (!fileType) {
         return false;
     }
 
+    offsetManager.attach(std::move(reader));
+    return parseInput(fileType);
+}
+
+bool Parser::parseInput(const FileTypeInfo* fileType) {
     const VersionedFileTypeInfo* versionedInfo = catalog.getVersionedFileTypeInfo(fileType);
 
     std::vector<std::string> structTypes;
@@ -47,6 +70,10 @@ bool Parser::parse() {
     offsetManager.setPrimaryOffset(0);
     offsetManager.setSecondaryOffset(secondaryOffsetStart);
 
+    if (traceLog) {
+        traceBuffer = std::make_unique<ParseTraceBuffer>(*traceLog, filename);
+    }
+
     if (exportMode && exporter) {
         exporter->beginDocument();
     }
@@ -61,27 +88,37 @@ bool Parser::parse() {
         exporter->endDocument();
     }
 
-    fileStream.close();
+    inputBytes = offsetManager.getLoadedSize();
+    offsetManager.detach();
+    traceBuffer.reset();
     return true;
 }
 
 void Parser::parseStruct(const std::string& structName, int arrayIndex) {
+    const auto structStarted = timeline ? Timeline::Clock::now() : Timeline::Clock::time_point{};
+    const bool wasPruned = pruned;
+    std::vector<const ProjectionNode*> inheritedNodes;
+    if (projection) {
+        inheritedNodes = selectedNodes;
+    }
+
     try {
         auto structDef = catalog.getStruct(structName);
         if (!structDef) {
             std::cerr << "Unknown struct: " << structName << std::endl;
             return;
         }
+        SchemaProfile::Scope profileScope(profileCursor, structName, false, 0, stringBytes);
 
         if (arrayIndex >= 0) {
-            logParse(fmt::format("parse_struct({}, [{}])", structName, arrayIndex));
+            logParse(TraceOp::StructElement, structName, arrayIndex);
         }
         else {
-            logParse(fmt::format("parse_struct({})", structName));
+            logParse(TraceOp::Struct, structName);
         }
 
         bool shouldEndNode = false;
-        if (exportMode && exporter) {
+        if (exporting()) {
             if (isProcessingRootTag) {
                 std::string lowerStructName = structName;
                 std::transform(lowerStructName.begin(), lowerStructName.end(),
@@ -110,12 +147,46 @@ void Parser::parseStruct(const std::string& structName, int arrayIndex) {
 
         indentLevel++;
 
+        // Paths continuing from the enclosing struct, plus any that start here.
+        std::vector<const ProjectionNode*> activeNodes;
+        bool selectsAll = false;
+        if (projection && !wasPruned) {
+            activeNodes = inheritedNodes;
+            if (const ProjectionNode* root = projection->getRoot(structName)) {
+                activeNodes.push_back(root);
+            }
+            for (const ProjectionNode* node : activeNodes) {
+                selectsAll = selectsAll || node->selectsAll();
+            }
+        }
+
         size_t structStartOffset = offsetManager.getPrimaryOffset();
-        for (const auto& member : structDef->getMembers()) {
+        const auto& members = structDef->getMembers();
+        for (size_t i = 0; i < members.size(); i++) {
+            const auto& member = members[i];
             if (processingArrayElement) {
                 offsetManager.setPrimaryOffset(structStartOffset);
             }
-            parseMember(member, structDef);
+
+            if (projection && !wasPruned) {
+                if (selectsAll) {
+                    selectedNodes = activeNodes;
+                }
+                else {
+                    selectedNodes.clear();
+                    for (const ProjectionNode* node : activeNodes) {
+                        if (const ProjectionNode* child = node->find(member.name)) {
+                            selectedNodes.push_back(child);
+                        }
+                    }
+                    pruned = selectedNodes.empty() && !projection->leadsToSelection(structDef.get(), i);
+                }
+                parseMember(member, structDef);
+                pruned = false;
+            }
+            else {
+                parseMember(member, structDef);
+            }
         }
 
         indentLevel--;
@@ -132,7 +203,7 @@ void Parser::parseStruct(const std::string& structName, int arrayIndex) {
             currentStructBaseOffset = previousStructBaseOffset;
         }
 
-        if (exportMode && exporter && shouldEndNode) {
+        if (exporting() && shouldEndNode) {
             exporter->endNode();
         }
     }
@@ -147,6 +218,14 @@ void Parser::parseStruct(const std::string& structName, int arrayIndex) {
             << offsetManager.getPrimaryOffset() << ", "
             << offsetManager.getSecondaryOffset() << ")" << std::endl;
     }
+
+    if (projection) {
+        pruned = wasPruned;
+        selectedNodes = std::move(inheritedNodes);
+    }
+    if (timeline) {
+        timeline->structSpan(structName, structStarted);
+    }
 }
 
 void Parser::parseMember(const StructMember& member, const std::shared_ptr<StructDefinition>& parentStruct, size_t arraySize) {
@@ -155,6 +234,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         std::cerr << "Unknown type: " << member.typeName << std::endl;
         return;
     }
+    SchemaProfile::Scope profileScope(profileCursor, member.typeName, true, typeDef->size, stringBytes);
     size_t originalSecondaryOffset = offsetManager.getRealSecondaryOffset();
     size_t arrayStructOffset = offsetManager.getPrimaryOffset();
     if (member.typeName == "array") {
@@ -199,10 +279,10 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
 
             const TypeDefinition* typeDef = catalog.getType(member.elementType);
             auto structDef = catalog.getStruct(member.elementType);
-            logParse(fmt::format("parse_member_array({}, {})", member.name, count));
+            logParse(TraceOp::Array, member.name, count);
             indentLevel++;
 
-            if (exportMode && exporter) {
+            if (exporting()) {
                 exporter->beginArray(member.name);
             }
 
@@ -214,7 +294,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
                 offsetManager.setSecondaryOffset(originalSecondaryOffset + totalArraySize);
 
                 for (uint32_t i = 0; i < count; i++) {
-                    if (exportMode && exporter) {
+                    if (exporting()) {
                         exporter->beginArrayEntry();
                     }
 
@@ -235,7 +315,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
                         elementBaseOffset += elementSize;
                     }
 
-                    if (exportMode && exporter) {
+                    if (exporting()) {
                         exporter->endArrayEntry();
                     }
                 }
@@ -263,13 +343,13 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
 
                         StructMember elementMember("entry", member.elementType, offsetManager.getPrimaryOffset(), useSecondaryForElements);
 
-                        if (exportMode && exporter) {
+                        if (exporting()) {
                             exporter->beginArrayEntry();
                         }
 
                         parseMember(elementMember, parentStruct);
 
-                        if (exportMode && exporter) {
+                        if (exporting()) {
                             exporter->endArrayEntry();
                         }
 
@@ -280,7 +360,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
                 }
             }
 
-            if (exportMode && exporter) {
+            if (exporting()) {
                 exporter->endArray();
             }
 
@@ -310,9 +390,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         typeDef->type == DataType::NULLABLE ||
         typeDef->type == DataType::CHAR_PTR);
 
-    std::string valueStr;
-    std::string logMessage;
-
+    fieldsDecoded++;
     switch (typeDef->type) {
     case DataType::BOOL: {
         bool value;
@@ -322,10 +400,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<bool>();
         }
-        valueStr = value ? "true" : "false";
-        logMessage = fmt::format("parse_member_bool({}, {})", member.name, valueStr);
+        logParse(TraceOp::Bool, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportBool(member.name, value);
         }
         break;
@@ -338,10 +415,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<int>();
         }
-        valueStr = std::to_string(value);
-        logMessage = fmt::format("parse_member_int({}, {})", member.name, valueStr);
+        logParse(TraceOp::Int, member.name, static_cast<uint32_t>(value));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportInt(member.name, value);
         }
         break;
@@ -354,10 +430,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<float>();
         }
-        valueStr = fmt::format("{:.5f}", value);
-        logMessage = fmt::format("parse_member_float({}, {})", member.name, valueStr);
+        logParse(TraceOp::Float, member.name, traceBits(value));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportFloat(member.name, value);
         }
         break;
@@ -381,18 +456,17 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
             data4 = offsetManager.readPrimary<uint64_t>();
         }
 
-        valueStr = fmt::format("{:08x}-{:04x}-{:04x}-{:04x}-{:012x}",
-            data1,
-            data2,
-            data3,
-            (data4 >> 48) & 0xFFFF,
-            data4 & 0xFFFFFFFFFFFFULL
-        );
+        logParse(TraceOp::Guid, member.name,
+            data1 | (static_cast<uint64_t>(data2) << 32) | (static_cast<uint64_t>(data3) << 48), data4);
 
-        logMessage = fmt::format("parse_member_guid({}, {})", member.name, valueStr);
-
-        if (exportMode && exporter) {
-            exporter->exportGuid(member.name, valueStr);
+        if (exporting()) {
+            exporter->exportGuid(member.name, fmt::format("{:08x}-{:04x}-{:04x}-{:04x}-{:012x}",
+                data1,
+                data2,
+                data3,
+                (data4 >> 48) & 0xFFFF,
+                data4 & 0xFFFFFFFFFFFFULL
+            ));
         }
         break;
     }
@@ -407,10 +481,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
             x = offsetManager.readPrimary<float>();
             y = offsetManager.readPrimary<float>();
         }
-        valueStr = fmt::format("x: {:.5f}, y: {:.5f}", x, y);
-        logMessage = fmt::format("parse_member_cSPVector2({}, {})", member.name, valueStr);
+        logParse(TraceOp::Vector2, member.name, traceBits(x, y));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportVector2(member.name, x, y);
         }
         break;
@@ -429,10 +502,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
             y = offsetManager.readPrimary<float>();
             z = offsetManager.readPrimary<float>();
         }
-        valueStr = fmt::format("x: {:.5f}, y: {:.5f}, z: {:.5f}", x, y, z);
-        logMessage = fmt::format("parse_member_cSPVector3({}, {})", member.name, valueStr);
+        logParse(TraceOp::Vector3, member.name, traceBits(x, y), traceBits(z));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportVector3(member.name, x, y, z);
         }
         break;
@@ -454,10 +526,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
             y = offsetManager.readPrimary<float>();
             z = offsetManager.readPrimary<float>();
         }
-        valueStr = fmt::format("w: {:.5f}, x: {:.5f}, y: {:.5f}, z: {:.5f}", w, x, y, z);
-        logMessage = fmt::format("parse_member_cSPVector4({}, {})", member.name, valueStr);
+        logParse(TraceOp::Vector4, member.name, traceBits(w, x), traceBits(y, z));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportQuaternion(member.name, w, x, y, z);
         }
         break;
@@ -466,12 +537,11 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         uint32_t offset = offsetManager.readPrimary<uint32_t>();
         if (offset != 0) {
             size_t currentSecondary = offsetManager.getSecondaryOffset();
-            std::string key = offsetManager.readString(true);
-            valueStr = key;
-            logMessage = fmt::format("parse_member_key({}, {})", member.name, valueStr);
+            std::string key = readSecondaryString();
+            logParse(TraceOp::Key, member.name, 0, 0, key);
 
-            if (exportMode && exporter) {
-                exporter->exportString(member.name, valueStr);
+            if (exporting()) {
+                exporter->exportString(member.name, key);
             }
         }
         else {
@@ -483,12 +553,11 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         uint32_t offset = offsetManager.readPrimary<uint32_t>();
         if (offset != 0) {
             size_t currentSecondary = offsetManager.getSecondaryOffset();
-            std::string key = offsetManager.readString(true);
-            valueStr = key;
-            logMessage = fmt::format("parse_member_cKeyAsset({}, {})", member.name, valueStr);
+            std::string key = readSecondaryString();
+            logParse(TraceOp::KeyAsset, member.name, 0, 0, key);
 
-            if (exportMode && exporter) {
-                exporter->exportString(member.name, valueStr);
+            if (exporting()) {
+                exporter->exportString(member.name, key);
             }
         }
         else {
@@ -501,12 +570,12 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         uint32_t assetString = offsetManager.readPrimary<uint32_t>();
         if (offset != 0) {
             size_t currentSecondary = offsetManager.getSecondaryOffset();
-            std::string str = offsetManager.readString(true);
+            std::string str = readSecondaryString();
             if (assetString != 0) {
-                std::string id = offsetManager.readString(true);
-                logMessage = fmt::format("parse_member_cLocalizedAssetString({}, {}, {})", member.name, str, id);
+                std::string id = readSecondaryString();
+                logParse(TraceOp::LocalizedStringId, member.name, 0, 0, str, id);
 
-                if (exportMode && exporter) {
+                if (exporting()) {
                     exporter->beginNode(member.name);
                     exporter->exportString("text", str);
                     exporter->exportString("id", id);
@@ -514,9 +583,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
                 }
             }
             else {
-                logMessage = fmt::format("parse_member_cLocalizedAssetString({}, {})", member.name, str);
+                logParse(TraceOp::LocalizedString, member.name, 0, 0, str);
 
-                if (exportMode && exporter) {
+                if (exporting()) {
                     exporter->exportString(member.name, str);
                 }
             }
@@ -530,12 +599,11 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         uint32_t offset = offsetManager.readPrimary<uint32_t>();
         if (offset > 0) {
             size_t currentSecondary = offsetManager.getSecondaryOffset();
-            std::string asset = offsetManager.readString(true);
-            valueStr = asset;
-            logMessage = fmt::format("parse_member_asset({}, {})", member.name, valueStr);
+            std::string asset = readSecondaryString();
+            logParse(TraceOp::Asset, member.name, 0, 0, asset);
 
-            if (exportMode && exporter) {
-                exporter->exportString(member.name, valueStr);
+            if (exporting()) {
+                exporter->exportString(member.name, asset);
             }
         }
         else {
@@ -547,12 +615,11 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         uint32_t offset = offsetManager.readPrimary<uint32_t>();
         if (offset > 0) {
             size_t currentSecondary = offsetManager.getSecondaryOffset();
-            std::string char_ptr = offsetManager.readString(true);
-            valueStr = char_ptr;
-            logMessage = fmt::format("parse_member_char*({}, {})", member.name, valueStr);
+            std::string char_ptr = readSecondaryString();
+            logParse(TraceOp::CharPtr, member.name, 0, 0, char_ptr);
 
-            if (exportMode && exporter) {
-                exporter->exportString(member.name, valueStr);
+            if (exporting()) {
+                exporter->exportString(member.name, char_ptr);
             }
         }
         else {
@@ -561,13 +628,17 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         break;
     }
     case DataType::CHAR: {
+        stringsRead++;
+        if (!exporting() && !traceEnabled()) {
+            offsetManager.skipString();
+            return;
+        }
         std::string string = offsetManager.readString();
-        valueStr = string;
         if (!string.empty() && string != "0") {
-            logMessage = fmt::format("parse_member_char({}, {})", member.name, valueStr);
+            logParse(TraceOp::Char, member.name, 0, 0, string);
 
-            if (exportMode && exporter) {
-                exporter->exportString(member.name, valueStr);
+            if (exporting()) {
+                exporter->exportString(member.name, string);
             }
         }
         else {
@@ -583,10 +654,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<uint32_t>();
         }
-        valueStr = std::to_string(value);
-        logMessage = fmt::format("parse_member_enum({}, {})", member.name, valueStr);
+        logParse(TraceOp::Enum, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportUInt32(member.name, value);
         }
         break;
@@ -599,10 +669,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<uint8_t>();
         }
-        valueStr = std::to_string(value);
-        logMessage = fmt::format("parse_member_uint8_t({}, {})", member.name, valueStr);
+        logParse(TraceOp::UInt8, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportUInt8(member.name, value);
         }
         break;
@@ -615,10 +684,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<uint16_t>();
         }
-        valueStr = std::to_string(value);
-        logMessage = fmt::format("parse_member_uint16_t({}, {})", member.name, valueStr);
+        logParse(TraceOp::UInt16, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportUInt16(member.name, value);
         }
         break;
@@ -631,10 +699,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<uint32_t>();
         }
-        valueStr = std::to_string(value);
-        logMessage = fmt::format("parse_member_uint32_t({}, {})", member.name, valueStr);
+        logParse(TraceOp::UInt32, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportUInt32(member.name, value);
         }
         break;
@@ -647,10 +714,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<uint64_t>();
         }
-        valueStr = fmt::format("0x{:X}", value);
-        logMessage = fmt::format("parse_member_uint64_t({}, {})", member.name, valueStr);
+        logParse(TraceOp::UInt64, member.name, value);
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportUInt64(member.name, value);
         }
         break;
@@ -663,10 +729,9 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         else {
             value = offsetManager.readPrimary<int64_t>();
         }
-        valueStr = fmt::format("0x{:X}", value);
-        logMessage = fmt::format("parse_member_int64_t({}, {})", member.name, valueStr);
+        logParse(TraceOp::Int64, member.name, static_cast<uint64_t>(value));
 
-        if (exportMode && exporter) {
+        if (exporting()) {
             exporter->exportInt64(member.name, value);
         }
         break;
@@ -679,10 +744,10 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
             auto targetStruct = catalog.getStruct(typeDef->targetType);
             if (targetStruct) {
                 if (member.hasCustomName) {
-                    logParse(fmt::format("parse_member_nullable({}, {})", member.name, typeDef->targetType));
+                    logParse(TraceOp::NullableNamed, member.name, 0, 0, typeDef->targetType);
                 }
                 else {
-                    logParse(fmt::format("parse_member_nullable({})", typeDef->targetType));
+                    logParse(TraceOp::Nullable, member.name, 0, 0, typeDef->targetType);
                 }
 
                 startNullableOffset = offsetManager.getRealSecondaryOffset();
@@ -698,7 +763,7 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
                 offsetManager.setPrimaryOffset(offsetManager.getSecondaryOffset());
                 offsetManager.setSecondaryOffset(originalSecondaryOffset + targetStruct->getFixedSize());
 
-                if (exportMode && exporter) {
+                if (exporting()) {
                     exporter->beginNode(member.name);
                     parseStruct(typeDef->targetType);
                     exporter->endNode();
@@ -725,17 +790,16 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
     }
     case DataType::STRUCT: {
         if (member.hasCustomName) {
-            logMessage = fmt::format("parse_member_struct({}, {})", member.name, typeDef->targetType);
+            logParse(TraceOp::StructMemberNamed, member.name, 0, 0, typeDef->targetType);
         }
         else {
-            logMessage = fmt::format("parse_member_struct({})", typeDef->targetType);
+            logParse(TraceOp::StructMember, member.name, 0, 0, typeDef->targetType);
         }
-        logParse(logMessage);
         size_t currentOffset = offsetManager.getPrimaryOffset();
         size_t previousBaseOffset = currentStructBaseOffset;
         currentStructBaseOffset = currentOffset;
 
-        if (exportMode && exporter && member.hasCustomName) {
+        if (exporting() && member.hasCustomName) {
             exporter->beginNode(member.name);
             parseStruct(typeDef->targetType);
             exporter->endNode();
@@ -748,17 +812,22 @@ void Parser::parseMember(const StructMember& member, const std::shared_ptr<Struc
         return;
     }
     default: {
-        valueStr = "unknown";
-        logMessage = fmt::format("parse_member_unknown({}, {})", member.name, valueStr);
+        logParse(TraceOp::Unknown, member.name);
         break;
     }
     }
+}
 
-    logParse(logMessage);
+bool Parser::exportToFile(const std::string& outputFile) {
+    if (exportMode && exporter) {
+        return exporter->saveToFile(outputFile);
+    }
+    return false;
 }
 
-void Parser::exportToFile(const std::string& outputFile) {
+bool Parser::exportToString(std::string& output) {
     if (exportMode && exporter) {
-        exporter->saveToFile(outputFile);
+        return exporter->saveToString(output);
     }
-}
\ No newline at end of file
+    return false;
+}
@@ -0,0 +1,94 @@
+#include "progress.h"
+#include <cstdio>
+#include <fmt/format.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    bool stderrIsTerminal() {
+#ifdef _WIN32
+        return _isatty(_fileno(stderr)) != 0;
+#else
+        return isatty(fileno(stderr)) != 0;
+#endif
+    }
+
+    std::string formatDuration(double seconds) {
+        auto total = static_cast<long long>(seconds + 0.5);
+        if (total >= 3600) {
+            return fmt::format("{}:{:02}:{:02}", total / 3600, total / 60 % 60, total % 60);
+        }
+        return fmt::format("{}:{:02}", total / 60, total % 60);
+    }
+}
+
+ProgressReporter::ProgressReporter(unsigned workerCount)
+    : workers(workerCount), terminal(stderrIsTerminal()), started(Clock::now()) {
+    timer = std::thread([this]() { run(); });
+}
+
+ProgressReporter::~ProgressReporter() {
+    finish();
+}
+
+void ProgressReporter::run() {
+    // A terminal line is cheap to redraw; a log gets a line every few seconds.
+    const auto interval = terminal ? std::chrono::milliseconds(250) : std::chrono::milliseconds(5000);
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopSignal.wait_for(lock, interval, [this]() { return stopping; })) {
+        draw(false);
+    }
+}
+
+void ProgressReporter::finish() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        if (stopping) return;
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    timer.join();
+    draw(true);
+}
+
+void ProgressReporter::draw(bool final) {
+    const uint64_t filesDone = done.load(std::memory_order_relaxed);
+    const uint64_t filesQueued = queued.load(std::memory_order_relaxed);
+    const uint64_t bytesDone = bytes.load(std::memory_order_relaxed);
+    const bool totalKnown = complete.load(std::memory_order_relaxed) || final;
+    const double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+
+    const double filesPerSecond = elapsed > 0 ? filesDone / elapsed : 0;
+    const double megabytesPerSecond = elapsed > 0 ? bytesDone / (1024.0 * 1024.0) / elapsed : 0;
+
+    std::string line;
+    if (final) {
+        line = fmt::format("{} file(s) in {}, {:.1f} MB/s, {:.0f} files/s",
+            filesDone, formatDuration(elapsed), megabytesPerSecond, filesPerSecond);
+    }
+    else {
+        std::string eta = "-";
+        if (totalKnown && filesPerSecond > 0 && filesQueued >= filesDone) {
+            eta = formatDuration((filesQueued - filesDone) / filesPerSecond);
+        }
+        line = fmt::format("{}/{}{} files, {:.1f} MB/s, {:.0f} files/s, ETA {}, {}/{} workers busy",
+            filesDone, filesQueued, totalKnown ? "" : "+", megabytesPerSecond, filesPerSecond, eta,
+            active.load(std::memory_order_relaxed), workers);
+    }
+
+    if (terminal) {
+        // Pad over the previous line, which may have been longer.
+        size_t width = line.size();
+        if (line.size() < lastWidth) line.append(lastWidth - line.size(), ' ');
+        lastWidth = width;
+        std::fprintf(stderr, "\r%s%s", line.c_str(), final ? "\n" : "");
+    }
+    else {
+        std::fprintf(stderr, "Progress: %s\n", line.c_str());
+    }
+    std::fflush(stderr);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// --progress: files done out of queued, throughput, ETA and busy workers on
+// stderr. Workers only bump atomic counters; a timer thread reads them and
+// redraws one status line, or logs a line every few seconds when stderr is
+// not a terminal.
+class ProgressReporter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Counts one queued file as active for its lifetime and done after it.
+    class Task {
+    private:
+        ProgressReporter* progress;
+
+    public:
+        explicit Task(ProgressReporter* reporter) : progress(reporter) {
+            if (progress) progress->active.fetch_add(1, std::memory_order_relaxed);
+        }
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task() {
+            if (progress) {
+                progress->active.fetch_sub(1, std::memory_order_relaxed);
+                progress->done.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+private:
+    std::atomic<uint64_t> queued{ 0 };
+    std::atomic<uint64_t> done{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<unsigned> active{ 0 };
+    std::atomic<bool> complete{ false };
+
+    const unsigned workers;
+    const bool terminal;
+    const Clock::time_point started;
+
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread timer;
+    size_t lastWidth = 0;
+
+    void run();
+    void draw(bool final);
+
+public:
+    explicit ProgressReporter(unsigned workerCount);
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+    ~ProgressReporter();
+
+    void addQueued(uint64_t files = 1) {
+        queued.fetch_add(files, std::memory_order_relaxed);
+    }
+
+    // The producer is done, so queued is the final total and ETA can be shown.
+    void setComplete() {
+        complete.store(true, std::memory_order_relaxed);
+    }
+
+    void addBytes(uint64_t count) {
+        bytes.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Stops the timer and prints the last status; also done by the destructor.
+    void finish();
+};
@@ -0,0 +1,142 @@
+#include "projection.h"
+#include <unordered_set>
+
+namespace {
+    std::vector<std::string> splitPath(const std::string& path) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find('.', start);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            parts.push_back(path.substr(start, end - start));
+            start = end + 1;
+        }
+        return parts;
+    }
+
+    // Struct a member descends into, or an empty string for leaf members.
+    std::string memberTarget(const Catalog& catalog, const StructMember& member) {
+        if (member.typeName == "array") {
+            return catalog.getStruct(member.elementType) ? member.elementType : std::string();
+        }
+        const TypeDefinition* typeDef = catalog.getType(member.typeName);
+        if (typeDef && (typeDef->type == DataType::STRUCT || typeDef->type == DataType::NULLABLE)) {
+            return typeDef->targetType;
+        }
+        return {};
+    }
+
+    const StructMember* findMember(const StructDefinition& structDef, const std::string& name) {
+        for (const auto& member : structDef.getMembers()) {
+            if (member.name == name) {
+                return &member;
+            }
+        }
+        return nullptr;
+    }
+}
+
+std::unique_ptr<Projection> Projection::compile(const Catalog& catalog,
+    const std::vector<std::string>& paths, std::string& error) {
+    auto projection = std::make_unique<Projection>();
+
+    for (const auto& path : paths) {
+        std::vector<std::string> parts = splitPath(path);
+        for (const auto& part : parts) {
+            if (part.empty()) {
+                error = "malformed path '" + path + "'";
+                return nullptr;
+            }
+        }
+
+        auto structDef = catalog.getStruct(parts[0]);
+        if (!structDef) {
+            error = "unknown struct '" + parts[0] + "' in '" + path + "'";
+            return nullptr;
+        }
+        for (size_t i = 1; i < parts.size(); i++) {
+            if (!structDef) {
+                error = "'" + parts[i - 1] + "' has no members in '" + path + "'";
+                return nullptr;
+            }
+            const StructMember* member = findMember(*structDef, parts[i]);
+            if (!member) {
+                error = "unknown member '" + parts[i] + "' of " + structDef->getName() + " in '" + path + "'";
+                return nullptr;
+            }
+            std::string target = memberTarget(catalog, *member);
+            structDef = target.empty() ? nullptr : catalog.getStruct(target);
+        }
+
+        // An existing node without children already keeps everything below it.
+        std::vector<ProjectionNode>* siblings = &projection->roots;
+        ProjectionNode* node = nullptr;
+        bool covered = false;
+        for (const auto& part : parts) {
+            ProjectionNode* next = nullptr;
+            for (auto& sibling : *siblings) {
+                if (sibling.name == part) {
+                    next = &sibling;
+                    break;
+                }
+            }
+            if (next && next->selectsAll()) {
+                covered = true;
+                break;
+            }
+            if (!next) {
+                siblings->push_back(ProjectionNode{ part, {} });
+                next = &siblings->back();
+            }
+            node = next;
+            siblings = &node->children;
+        }
+        if (!covered) {
+            node->children.clear();
+        }
+    }
+
+    // Structs that contain a selected struct somewhere below them.
+    std::unordered_set<std::string> reaching;
+    for (const auto& root : projection->roots) {
+        reaching.insert(root.name);
+    }
+    const std::vector<std::string> structNames = catalog.getStructNames();
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& name : structNames) {
+            if (reaching.count(name)) {
+                continue;
+            }
+            for (const auto& member : catalog.getStruct(name)->getMembers()) {
+                if (reaching.count(memberTarget(catalog, member))) {
+                    reaching.insert(name);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (const auto& name : structNames) {
+        auto structDef = catalog.getStruct(name);
+        std::vector<bool>& route = projection->routes[structDef.get()];
+        for (const auto& member : structDef->getMembers()) {
+            route.push_back(reaching.count(memberTarget(catalog, member)) > 0);
+        }
+    }
+
+    return projection;
+}
+
+const ProjectionNode* Projection::getRoot(const std::string& structName) const {
+    for (const auto& root : roots) {
+        if (root.name == structName) {
+            return &root;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "catalog.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// One component of a --select path. A node without children keeps the whole
+// subtree below it.
+struct ProjectionNode {
+    std::string name;
+    std::vector<ProjectionNode> children;
+
+    bool selectsAll() const {
+        return children.empty();
+    }
+
+    const ProjectionNode* find(const std::string& memberName) const {
+        for (const auto& child : children) {
+            if (child.name == memberName) {
+                return &child;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// --select paths compiled against the catalog. Each path starts with a struct
+// name (Noun.assetId, cAssetProperty.name) and matches wherever that struct
+// occurs, at the root or nested.
+class Projection {
+private:
+    std::vector<ProjectionNode> roots;
+    // Per struct, the members whose subtree contains a selected struct.
+    std::unordered_map<const StructDefinition*, std::vector<bool>> routes;
+
+public:
+    static std::unique_ptr<Projection> compile(const Catalog& catalog,
+        const std::vector<std::string>& paths, std::string& error);
+
+    const ProjectionNode* getRoot(const std::string& structName) const;
+
+    bool leadsToSelection(const StructDefinition* structDef, size_t memberIndex) const {
+        auto it = routes.find(structDef);
+        return it != routes.end() && it->second[memberIndex];
+    }
+};
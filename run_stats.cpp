@@ -0,0 +1,119 @@
+#include "run_stats.h"
+#include <fstream>
+#include <fmt/format.h>
+
+namespace {
+    constexpr double MB = 1024.0 * 1024.0;
+}
+
+void FileTypeStats::add(const FileTypeStats& other) {
+    files += other.files;
+    inputBytes += other.inputBytes;
+    fields += other.fields;
+    strings += other.strings;
+    outputBytes += other.outputBytes;
+    decodeSeconds += other.decodeSeconds;
+    formatSeconds += other.formatSeconds;
+    writeSeconds += other.writeSeconds;
+    decodeAllocs.add(other.decodeAllocs);
+    formatAllocs.add(other.formatAllocs);
+    writeAllocs.add(other.writeAllocs);
+    if (other.filePeak > filePeak) {
+        filePeak = other.filePeak;
+        filePeakPath = other.filePeakPath;
+    }
+}
+
+void FileTypeStats::notePeak(const AllocUsage& file, const std::string& path) {
+    if (file.peakLive > filePeak) {
+        filePeak = file.peakLive;
+        filePeakPath = path;
+    }
+}
+
+FileTypeStats& RunStats::local(const std::string& fileType) {
+    return shards.local()[fileType];
+}
+
+std::map<std::string, FileTypeStats> RunStats::merged() {
+    std::map<std::string, FileTypeStats> totals;
+    shards.forEach([&](const auto& shard) {
+        for (const auto& [type, stats] : shard) {
+            totals[type].add(stats);
+        }
+    });
+    return totals;
+}
+
+void RunStats::printTable(std::ostream& out, double wallSeconds) {
+    std::map<std::string, FileTypeStats> totals = merged();
+    FileTypeStats all;
+    for (const auto& entry : totals) {
+        all.add(entry.second);
+    }
+
+    out << fmt::format("{:<20} {:>8} {:>10} {:>11} {:>10} {:>10} {:>9} {:>9} {:>9}\n",
+        "type", "files", "in MB", "fields", "strings", "out MB", "decode s", "format s", "write s");
+    auto row = [&](const std::string& name, const FileTypeStats& s) {
+        out << fmt::format("{:<20} {:>8} {:>10.2f} {:>11} {:>10} {:>10.2f} {:>9.3f} {:>9.3f} {:>9.3f}\n",
+            name, s.files, s.inputBytes / MB, s.fields, s.strings, s.outputBytes / MB,
+            s.decodeSeconds, s.formatSeconds, s.writeSeconds);
+    };
+    for (const auto& [type, stats] : totals) {
+        row(type, stats);
+    }
+    row("total", all);
+    if (allocations) {
+        out << fmt::format("\n{:<20} {:>11} {:>9} {:>10} {:>9} {:>10} {:>9} {:>9}  {}\n",
+            "type", "allocs", "per field", "decode MB", "tree MB", "format MB", "write MB", "peak MB", "largest peak");
+        auto allocRow = [&](const std::string& name, const FileTypeStats& s) {
+            uint64_t count = s.decodeAllocs.allocations + s.formatAllocs.allocations + s.writeAllocs.allocations;
+            out << fmt::format("{:<20} {:>11} {:>9.2f} {:>10.2f} {:>9.2f} {:>10.2f} {:>9.2f} {:>9.2f}  {}\n",
+                name, count, s.fields > 0 ? static_cast<double>(s.decodeAllocs.allocations) / s.fields : 0.0,
+                s.decodeAllocs.bytes / MB, s.decodeAllocs.retained / MB, s.formatAllocs.bytes / MB,
+                s.writeAllocs.bytes / MB, s.filePeak / MB, s.filePeakPath);
+        };
+        for (const auto& [type, stats] : totals) {
+            allocRow(type, stats);
+        }
+        allocRow("total", all);
+    }
+    if (wallSeconds > 0) {
+        out << fmt::format("{} file(s) in {:.3f}s: {:.0f} files/s, {:.1f} MB/s in, {:.1f} MB/s out\n",
+            all.files, wallSeconds, all.files / wallSeconds, all.inputBytes / MB / wallSeconds,
+            all.outputBytes / MB / wallSeconds);
+    }
+}
+
+bool RunStats::writeJson(const std::string& path, double wallSeconds) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    auto fields = [&](const FileTypeStats& s) {
+        std::string text = fmt::format("\"files\": {}, \"input_bytes\": {}, \"fields\": {}, \"strings\": {}, \"output_bytes\": {}, "
+            "\"decode_s\": {:.6f}, \"format_s\": {:.6f}, \"write_s\": {:.6f}",
+            s.files, s.inputBytes, s.fields, s.strings, s.outputBytes, s.decodeSeconds, s.formatSeconds, s.writeSeconds);
+        if (allocations) {
+            auto usage = [](const AllocUsage& u) {
+                return fmt::format("{{ \"allocations\": {}, \"bytes\": {}, \"peak_bytes\": {} }}", u.allocations, u.bytes, u.peakLive);
+            };
+            text += fmt::format(", \"decode_allocs\": {}, \"tree_bytes\": {}, \"format_allocs\": {}, \"write_allocs\": {}, "
+                "\"file_peak_bytes\": {}", usage(s.decodeAllocs), s.decodeAllocs.retained, usage(s.formatAllocs),
+                usage(s.writeAllocs), s.filePeak);
+        }
+        return text;
+    };
+
+    std::map<std::string, FileTypeStats> totals = merged();
+    FileTypeStats all;
+    out << fmt::format("{{\n  \"wall_s\": {:.6f},\n  \"types\": {{", wallSeconds);
+    bool first = true;
+    for (const auto& [type, stats] : totals) {
+        all.add(stats);
+        out << (first ? "\n" : ",\n") << fmt::format("    \"{}\": {{ {} }}", type, fields(stats));
+        first = false;
+    }
+    out << fmt::format("\n  }},\n  \"total\": {{ {} }}\n}}\n", fields(all));
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+#include "alloc_stats.h"
+#include "thread_shards.h"
+
+// Totals for one file type over a run. Times are summed over all workers.
+struct FileTypeStats {
+    uint64_t files = 0;
+    uint64_t inputBytes = 0;
+    uint64_t fields = 0;
+    uint64_t strings = 0;
+    uint64_t outputBytes = 0;
+    double decodeSeconds = 0;
+    double formatSeconds = 0;
+    double writeSeconds = 0;
+
+    // --track-allocs. Counts and bytes are summed; peaks and the tree size,
+    // i.e. what a decoded document still holds, are the largest of any file.
+    AllocUsage decodeAllocs;
+    AllocUsage formatAllocs;
+    AllocUsage writeAllocs;
+    uint64_t filePeak = 0;
+    std::string filePeakPath;
+
+    void notePeak(const AllocUsage& file, const std::string& path);
+    void add(const FileTypeStats& other);
+};
+
+// --stats: per file type counters. Every thread updates its own shard without
+// locking; shards are only merged when the run is reported, so the cost per
+// file is a hash lookup and a few additions.
+class RunStats {
+private:
+    ThreadShards<std::unordered_map<std::string, FileTypeStats>> shards;
+    bool allocations = false;
+
+public:
+    RunStats() = default;
+    RunStats(const RunStats&) = delete;
+    RunStats& operator=(const RunStats&) = delete;
+
+    // Adds the --track-allocs columns to the report.
+    void showAllocations() {
+        allocations = true;
+    }
+
+    // The calling thread's counters for a file type.
+    FileTypeStats& local(const std::string& fileType);
+
+    // Call once the workers are idle.
+    std::map<std::string, FileTypeStats> merged();
+
+    void printTable(std::ostream& out, double wallSeconds);
+    bool writeJson(const std::string& path, double wallSeconds);
+};
@@ -0,0 +1,115 @@
+#include "schema_profile.h"
+#include <algorithm>
+#include <fstream>
+#include <fmt/format.h>
+
+namespace {
+    // True if name is one of the components of stack; used so a recursive
+    // struct's inclusive time is counted once per outermost call.
+    bool onStack(std::string_view stack, std::string_view name) {
+        size_t start = 0;
+        while (start <= stack.size()) {
+            size_t end = stack.find(';', start);
+            if (end == std::string_view::npos) end = stack.size();
+            if (stack.substr(start, end - start) == name) return true;
+            start = end + 1;
+        }
+        return false;
+    }
+}
+
+void SchemaNodeStats::add(const SchemaNodeStats& other) {
+    calls += other.calls;
+    inclusiveNs += other.inclusiveNs;
+    exclusiveNs += other.exclusiveNs;
+    bytes += other.bytes;
+    member = other.member;
+}
+
+void SchemaProfile::Cursor::enter(std::string_view name, bool member, size_t fixedBytes, size_t stringBytes) {
+    frames.push_back(Frame{ path.size(), Clock::now(), 0, fixedBytes, stringBytes, member });
+    if (!path.empty()) path += ';';
+    path += name;
+}
+
+void SchemaProfile::Cursor::leave(size_t stringBytes) {
+    Frame frame = frames.back();
+    frames.pop_back();
+    uint64_t inclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frame.start).count();
+
+    SchemaNodeStats& stats = profile->shards.local()[path];
+    stats.calls++;
+    stats.inclusiveNs += inclusive;
+    stats.exclusiveNs += inclusive > frame.childNs ? inclusive - frame.childNs : 0;
+    stats.bytes += frame.fixedBytes + (stringBytes - frame.startStringBytes);
+    stats.member = frame.member;
+
+    if (!frames.empty()) {
+        frames.back().childNs += inclusive;
+        frames.back().fixedBytes += frame.fixedBytes;
+    }
+    path.resize(frame.pathLength);
+}
+
+std::map<std::string, SchemaNodeStats> SchemaProfile::merged() {
+    std::map<std::string, SchemaNodeStats> totals;
+    shards.forEach([&](const auto& shard) {
+        for (const auto& [path, stats] : shard) {
+            totals[path].add(stats);
+        }
+    });
+    return totals;
+}
+
+void SchemaProfile::printReport(std::ostream& out, size_t rows) {
+    std::map<std::string, SchemaNodeStats> paths = merged();
+    std::map<std::string, SchemaNodeStats> structs;
+    std::map<std::string, SchemaNodeStats> members;
+    uint64_t totalNs = 0;
+    for (const auto& [path, stats] : paths) {
+        size_t split = path.rfind(';');
+        std::string_view stack = split == std::string::npos ? std::string_view{} : std::string_view(path).substr(0, split);
+        std::string name = split == std::string::npos ? path : path.substr(split + 1);
+
+        SchemaNodeStats& total = (stats.member ? members : structs)[name];
+        SchemaNodeStats counted = stats;
+        if (onStack(stack, name)) {
+            counted.inclusiveNs = 0;
+            counted.bytes = 0;
+        }
+        total.add(counted);
+        totalNs += stats.exclusiveNs;
+    }
+
+    auto table = [&](const char* title, const std::map<std::string, SchemaNodeStats>& byName) {
+        std::vector<std::pair<std::string, SchemaNodeStats>> ranked(byName.begin(), byName.end());
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+            return a.second.exclusiveNs > b.second.exclusiveNs;
+        });
+        if (ranked.size() > rows) ranked.resize(rows);
+
+        out << fmt::format("{:<32} {:>10} {:>11} {:>11} {:>7} {:>10}\n",
+            title, "calls", "incl ms", "excl ms", "excl %", "MB");
+        for (const auto& [name, stats] : ranked) {
+            out << fmt::format("{:<32} {:>10} {:>11.3f} {:>11.3f} {:>7.1f} {:>10.2f}\n",
+                name, stats.calls, stats.inclusiveNs / 1e6, stats.exclusiveNs / 1e6,
+                totalNs > 0 ? stats.exclusiveNs * 100.0 / totalNs : 0.0, stats.bytes / (1024.0 * 1024.0));
+        }
+    };
+    table("struct", structs);
+    out << "\n";
+    table("member type", members);
+}
+
+bool SchemaProfile::writeFolded(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    for (const auto& [stack, stats] : merged()) {
+        if (stats.exclusiveNs > 0) {
+            out << stack << ' ' << stats.exclusiveNs << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include "thread_shards.h"
+
+// Totals for one schema path, e.g. "Noun;cGraphicsData;asset". Bytes are
+// inclusive: the fixed size of every member below the path plus the string
+// data they read.
+struct SchemaNodeStats {
+    uint64_t calls = 0;
+    uint64_t inclusiveNs = 0;
+    uint64_t exclusiveNs = 0;
+    uint64_t bytes = 0;
+    bool member = false;
+
+    void add(const SchemaNodeStats& other);
+};
+
+// --profile-schema: decode time attributed to catalog structs and member
+// types. Parsers record into per-thread shards like RunStats; paths are
+// only merged for the report.
+class SchemaProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // One parser's position in the schema while it decodes.
+    class Cursor {
+    private:
+        struct Frame {
+            size_t pathLength;
+            Clock::time_point start;
+            uint64_t childNs;
+            uint64_t fixedBytes;
+            size_t startStringBytes;
+            bool member;
+        };
+
+        SchemaProfile* profile = nullptr;
+        std::string path;
+        std::vector<Frame> frames;
+
+    public:
+        void attach(SchemaProfile* target) {
+            profile = target;
+        }
+
+        bool active() const {
+            return profile != nullptr;
+        }
+
+        void enter(std::string_view name, bool member, size_t fixedBytes, size_t stringBytes);
+        void leave(size_t stringBytes);
+    };
+
+    // Enters a struct or member for its lifetime, exceptions included.
+    class Scope {
+    private:
+        Cursor* cursor;
+        const size_t* stringBytes;
+
+    public:
+        Scope(Cursor& target, std::string_view name, bool member, size_t fixedBytes, const size_t& stringCounter)
+            : cursor(target.active() ? &target : nullptr), stringBytes(&stringCounter) {
+            if (cursor) {
+                cursor->enter(name, member, fixedBytes, *stringBytes);
+            }
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            if (cursor) {
+                cursor->leave(*stringBytes);
+            }
+        }
+    };
+
+private:
+    ThreadShards<std::unordered_map<std::string, SchemaNodeStats>> shards;
+
+public:
+    SchemaProfile() = default;
+    SchemaProfile(const SchemaProfile&) = delete;
+    SchemaProfile& operator=(const SchemaProfile&) = delete;
+
+    // Call once the workers are idle.
+    std::map<std::string, SchemaNodeStats> merged();
+
+    // Structs and member types ranked by exclusive time, rows of each.
+    void printReport(std::ostream& out, size_t rows);
+    // One line per schema path with its exclusive nanoseconds, the input
+    // flamegraph.pl and speedscope expect.
+    bool writeFolded(const std::string& path);
+};
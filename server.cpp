@@ -0,0 +1,163 @@
+#include "server.h"
+#include "projection.h"
+#include <vector>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+namespace {
+    bool readLine(std::FILE* in, std::string& line) {
+        line.clear();
+        int c;
+        while ((c = std::fgetc(in)) != EOF) {
+            if (c == '\n') {
+                return true;
+            }
+            line.push_back(static_cast<char>(c));
+        }
+        return !line.empty();
+    }
+
+    void writeReply(std::FILE* out, bool ok, const std::string& payload) {
+        std::fprintf(out, "%s %zu\n", ok ? "ok" : "error", payload.size());
+        std::fwrite(payload.data(), 1, payload.size(), out);
+        std::fflush(out);
+    }
+}
+
+bool ParseServer::handle(const std::string& request, std::string& reply) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = request.find('\t', start);
+        fields.push_back(request.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) {
+            break;
+        }
+        start = tab + 1;
+    }
+    if (!fields.empty() && !fields.back().empty() && fields.back().back() == '\r') {
+        fields.back().pop_back();
+    }
+
+    if (fields.size() < 2 || fields.size() > 3 || fields[1].empty()) {
+        reply = "expected <xml|yaml>\\t<input>[\\t<output>]";
+        return false;
+    }
+    const std::string& format = fields[0];
+    if (format != "xml" && format != "yaml") {
+        reply = "unsupported format: " + format;
+        return false;
+    }
+
+    try {
+        Parser parser(catalog, fields[1], true, false, format);
+        parser.setProjection(projection);
+        if (!parser.parse()) {
+            reply = "cannot parse " + fields[1];
+            return false;
+        }
+
+        if (fields.size() == 3 && !fields[2].empty()) {
+            std::error_code ec;
+            fs::path outPath = fields[2];
+            if (outPath.has_parent_path()) {
+                fs::create_directories(outPath.parent_path(), ec);
+            }
+            if (!parser.exportToFile(outPath.string())) {
+                reply = "cannot write " + outPath.string();
+                return false;
+            }
+            reply = outPath.string();
+            return true;
+        }
+
+        if (!parser.exportToString(reply)) {
+            reply = "cannot export " + fields[1];
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        reply = e.what();
+        return false;
+    }
+}
+
+void ParseServer::serve(std::FILE* in, std::FILE* out) {
+    std::string request;
+    std::string reply;
+    while (readLine(in, request)) {
+        if (request.empty()) {
+            continue;
+        }
+        bool ok = handle(request, reply);
+        writeReply(out, ok, reply);
+    }
+}
+
+bool ParseServer::serveSocket(const std::string& socketPath, std::string& error) {
+#ifdef _WIN32
+    error = "Unix domain sockets are not supported on this platform";
+    return false;
+#else
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long";
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        error = "cannot create socket";
+        return false;
+    }
+    ::unlink(socketPath.c_str());
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) {
+        ::close(listener);
+        error = "cannot listen on " + socketPath;
+        return false;
+    }
+
+    // A client hanging up mid-reply must not take the server down.
+    signal(SIGPIPE, SIG_IGN);
+
+    while (true) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            int err = errno;
+            if (err == EINTR || err == ECONNABORTED || err == EPROTO) {
+                continue;
+            }
+            // Out of descriptors or memory: wait for some to be released
+            // instead of spinning on accept.
+            if (err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            ::close(listener);
+            error = "accept failed: " + std::string(std::strerror(err));
+            return false;
+        }
+        int writeSide = dup(connection);
+        std::FILE* in = fdopen(connection, "r");
+        std::FILE* out = writeSide >= 0 ? fdopen(writeSide, "w") : nullptr;
+        if (in && out) {
+            serve(in, out);
+        }
+        if (in) std::fclose(in); else ::close(connection);
+        if (out) std::fclose(out); else if (writeSide >= 0) ::close(writeSide);
+    }
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "catalog.h"
+#include <cstdio>
+#include <string>
+
+class Projection;
+
+// Resident parser for pipelines that would otherwise start one process per
+// asset. The catalog is built once and shared by every request.
+//
+// Request, one line:  <xml|yaml>\t<input path>[\t<output path>]
+// Reply:              ok <N>\n<N bytes>   or   error <N>\n<N bytes>
+//
+// Without an output path the reply carries the exported document, otherwise
+// the file is written and the reply carries its path.
+class ParseServer {
+private:
+    const Catalog& catalog;
+    const Projection* projection;
+
+    bool handle(const std::string& request, std::string& reply);
+
+public:
+    ParseServer(const Catalog& catalog, const Projection* projection)
+        : catalog(catalog), projection(projection) {
+    }
+
+    // Answers requests until the input ends.
+    void serve(std::FILE* in, std::FILE* out);
+
+    // Listens on a Unix domain socket and serves one connection at a time.
+    // Only returns on error; unavailable on Windows.
+    bool serveSocket(const std::string& socketPath, std::string& error);
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// One T per thread that records into it, for counters that are updated too
+// often to share a lock. local() only locks the first time a thread asks;
+// the shards are only read together once the threads are idle.
+template<typename T>
+class ThreadShards {
+private:
+    static inline std::atomic<uint64_t> nextId{ 1 };
+
+    const uint64_t id;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<T>> shards;
+
+public:
+    ThreadShards() : id(nextId++) {
+    }
+    ThreadShards(const ThreadShards&) = delete;
+    ThreadShards& operator=(const ThreadShards&) = delete;
+
+    // The calling thread's shard.
+    T& local() {
+        // thread_local is shared by every set of the same T, so shards are
+        // looked up by the set's id; ids are never reused, unlike addresses,
+        // so a dead set's entry is never hit again. The last one used is
+        // kept aside, as a thread nearly always records into one set.
+        thread_local uint64_t lastId = 0;
+        thread_local T* last = nullptr;
+        if (lastId == id) {
+            return *last;
+        }
+        thread_local std::unordered_map<uint64_t, T*> owned;
+        T*& shard = owned[id];
+        if (!shard) {
+            std::lock_guard<std::mutex> lock(mutex);
+            shards.push_back(std::make_unique<T>());
+            shard = shards.back().get();
+        }
+        lastId = id;
+        last = shard;
+        return *shard;
+    }
+
+    // Calls visit on every shard in the order the threads first recorded.
+    template<typename Visit>
+    void forEach(Visit&& visit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& shard : shards) {
+            visit(*shard);
+        }
+    }
+};
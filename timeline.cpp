@@ -0,0 +1,49 @@
+#include "timeline.h"
+#include "json_escape.h"
+#include <cstdio>
+#include <fmt/format.h>
+
+Timeline::Timeline() : origin(Clock::now()) {
+}
+
+void Timeline::span(const char* category, std::string name, Clock::time_point start, Clock::time_point end,
+    std::string file) {
+    buffers.local().push_back(Event{ category, std::move(name), std::move(file),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() });
+}
+
+bool Timeline::write(const std::string& path) {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+
+    std::string text = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    text += "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"recap_parser\"}}";
+    // One trace thread per buffer, i.e. per thread that recorded anything.
+    size_t tid = 0;
+    buffers.forEach([&](const std::vector<Event>& buffer) {
+        text += fmt::format(",\n{{\"ph\":\"M\",\"pid\":1,\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":\"thread {}\"}}}}", tid, tid);
+        for (const Event& event : buffer) {
+            text += fmt::format(",\n{{\"ph\":\"X\",\"pid\":1,\"tid\":{},\"cat\":\"{}\",\"ts\":{:.3f},\"dur\":{:.3f},\"name\":\"",
+                tid, event.category, event.startNs / 1000.0, event.durationNs / 1000.0);
+            appendJsonEscaped(text, event.name);
+            text += "\"";
+            if (!event.file.empty()) {
+                text += ",\"args\":{\"file\":\"";
+                appendJsonEscaped(text, event.file);
+                text += "\"}";
+            }
+            text += "}";
+        }
+        if (text.size() > (1 << 20)) {
+            std::fwrite(text.data(), 1, text.size(), out);
+            text.clear();
+        }
+        tid++;
+    });
+    text += "\n]}\n";
+    std::fwrite(text.data(), 1, text.size(), out);
+    return std::fclose(out) == 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "thread_shards.h"
+
+// --trace: a timeline of the run in the Chrome trace-event format, which
+// chrome://tracing and ui.perfetto.dev open directly. Every thread appends
+// complete ("X") events to its own buffer; buffers are only joined when the
+// file is written, so recording a span takes no lock.
+class Timeline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Struct decodes shorter than this are left out, or every field of a
+    // large export would become its own event.
+    static constexpr std::chrono::microseconds MIN_STRUCT_SPAN{ 100 };
+
+private:
+    struct Event {
+        const char* category;
+        std::string name;
+        std::string file;
+        int64_t startNs;
+        int64_t durationNs;
+    };
+    const Clock::time_point origin;
+    ThreadShards<std::vector<Event>> buffers;
+
+public:
+    Timeline();
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    // A finished span on the calling thread; file, if given, shows in its args.
+    void span(const char* category, std::string name, Clock::time_point start, Clock::time_point end,
+        std::string file = {});
+
+    // Records a struct decode that started at start, if it took long enough.
+    void structSpan(const std::string& structName, Clock::time_point start) {
+        Clock::time_point end = Clock::now();
+        if (end - start >= MIN_STRUCT_SPAN) {
+            span("struct", structName, start, end);
+        }
+    }
+
+    // Call once the threads that record are idle.
+    bool write(const std::string& path);
+
+    // Records the span from construction to destruction; a no-op without a timeline.
+    class Scope {
+    private:
+        Timeline* timeline;
+        const char* category;
+        std::string name;
+        std::string file;
+        Clock::time_point start;
+
+    public:
+        Scope(Timeline* timeline, const char* category, std::string name, std::string file = {})
+            : timeline(timeline), category(category), name(std::move(name)), file(std::move(file)),
+            start(timeline ? Clock::now() : Clock::time_point{}) {
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            if (timeline) {
+                timeline->span(category, std::move(name), start, Clock::now(), std::move(file));
+            }
+        }
+    };
+};
@@ -0,0 +1,611 @@
+// Writes a synthetic, schema-valid asset corpus from the Catalog definitions,
+// for benchmarks and regression runs that cannot ship real game data.
+//
+//   recap_corpus_gen -o <dir> [--count N] [--seed S] [--types noun,phase]
+//                    [--array-min A] [--array-max B] [--string-min C] [--string-max D]
+//                    [--fill F] [--max-depth N] [--game-version V]
+//
+// Every file is laid out by walking the file type's structs exactly the way
+// Parser::parseStruct and Parser::parseMember read them: the same primary and
+// secondary cursors, struct base offsets and array/nullable rules. Wherever
+// the parser would read a value, the generator writes one. Array counts,
+// nullable flags, string pointers and text are drawn from a generator seeded
+// by --seed, the file type and the file index, so a corpus is reproducible
+// and any single file can be regenerated on its own.
+
+#include <CLI/CLI.hpp>
+
+#include "catalog.h"
+#include "hash.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stack>
+#include <string>
+#include <vector>
+
+namespace {
+    struct Knobs {
+        uint32_t arrayMin = 0;
+        uint32_t arrayMax = 4;
+        size_t stringMin = 4;
+        size_t stringMax = 24;
+        double fill = 0.75;
+        int maxDepth = 8;
+    };
+
+    // Output bytes plus who wrote them. The catalog's layouts overlap in places
+    // (a member wider than the gap to the next, or two members at one offset),
+    // which the parser tolerates, so plain values only fill bytes nobody has
+    // written yet. Layout values (flags, counts, string pointers and text) win
+    // over plain ones; a layout value landing on an earlier one is counted,
+    // since the parser would then not read back the layout that was generated.
+    class ByteImage {
+    private:
+        enum : uint8_t { EMPTY, VALUE, LAYOUT };
+        std::vector<char> bytes;
+        std::vector<uint8_t> owner;
+
+    public:
+        size_t conflicts = 0;
+
+        void write(size_t offset, const void* source, size_t length, bool layout) {
+            extend(offset + length);
+            const char* from = static_cast<const char*>(source);
+            for (size_t i = 0; i < length; i++) {
+                uint8_t& current = owner[offset + i];
+                if (!layout) {
+                    if (current == EMPTY) {
+                        bytes[offset + i] = from[i];
+                        current = VALUE;
+                    }
+                    continue;
+                }
+                if (current == LAYOUT && bytes[offset + i] != from[i]) {
+                    conflicts++;
+                }
+                bytes[offset + i] = from[i];
+                current = LAYOUT;
+            }
+        }
+
+        // Fills the bytes of value that no layout value holds yet and returns
+        // what the parser will then read there.
+        template<typename T>
+        T merge(size_t offset, T value) {
+            extend(offset + sizeof(T));
+            char* wanted = reinterpret_cast<char*>(&value);
+            for (size_t i = 0; i < sizeof(T); i++) {
+                if (owner[offset + i] == LAYOUT) {
+                    wanted[i] = bytes[offset + i];
+                }
+            }
+            write(offset, &value, sizeof(T), true);
+            return value;
+        }
+
+        // Also reserves space that the parser skips over, e.g. the primary block.
+        void extend(size_t size) {
+            if (bytes.size() < size) {
+                bytes.resize(size, 0);
+                owner.resize(size, EMPTY);
+            }
+        }
+
+        const std::vector<char>& getBytes() const {
+            return bytes;
+        }
+    };
+
+    // The write-side twin of OffsetManager: the same two cursors, but every
+    // read becomes a write of a chosen value.
+    class OffsetWriter {
+    private:
+        ByteImage& image;
+        size_t primaryOffset = 0;
+        size_t secondaryOffset = 0;
+
+    public:
+        explicit OffsetWriter(ByteImage& image) : image(image) {
+        }
+
+        void setPrimaryOffset(size_t offset) { primaryOffset = offset; }
+        void setSecondaryOffset(size_t offset) { secondaryOffset = offset; }
+        size_t getPrimaryOffset() const { return primaryOffset; }
+        size_t getSecondaryOffset() const { return secondaryOffset; }
+        void advancePrimary(size_t bytes) { primaryOffset += bytes; }
+
+        template<typename T>
+        void writePrimary(T value, bool layout = false) {
+            image.write(primaryOffset, &value, sizeof(T), layout);
+            primaryOffset += sizeof(T);
+        }
+
+        // Writes a flag or count around whatever an overlapping member already
+        // put there, and returns what the parser will find. A result above limit
+        // is overwritten instead, so a stray string cannot become a huge count.
+        template<typename T>
+        T claimAt(size_t offset, T value, T limit = std::numeric_limits<T>::max()) {
+            T merged = image.merge(offset, value);
+            if (merged <= limit) {
+                return merged;
+            }
+            image.write(offset, &value, sizeof(T), true);
+            return value;
+        }
+
+        template<typename T>
+        T claimPrimary(T value, T limit = std::numeric_limits<T>::max()) {
+            T result = claimAt(primaryOffset, value, limit);
+            primaryOffset += sizeof(T);
+            return result;
+        }
+
+        void writeString(const std::string& text, bool useSecondary) {
+            size_t& offset = useSecondary ? secondaryOffset : primaryOffset;
+            image.write(offset, text.c_str(), text.size() + 1, true);
+            offset += text.size() + 1;
+        }
+    };
+
+    class CorpusWriter {
+    private:
+        const Catalog& catalog;
+        const Knobs& knobs;
+        std::mt19937_64 random;
+        ByteImage image;
+        OffsetWriter offsetManager;
+
+        // Mirrors Parser's walk state; see parser.cpp.
+        size_t currentStructBaseOffset = 0;
+        std::stack<size_t> structBaseOffsetStack;
+        bool secOffsetStruct = false;
+        bool processingArrayElement = false;
+        bool isInsideNullable = false;
+        size_t startNullableOffset = 0;
+        int depth = 0;
+
+        bool chance() {
+            return std::uniform_real_distribution<double>(0, 1)(random) < knobs.fill;
+        }
+
+        uint32_t arrayCount() {
+            if (depth > knobs.maxDepth || knobs.arrayMax == 0) {
+                return 0;
+            }
+            return std::uniform_int_distribution<uint32_t>(knobs.arrayMin, std::max(knobs.arrayMin, knobs.arrayMax))(random);
+        }
+
+        std::string text(size_t maxLength = SIZE_MAX) {
+            static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+            size_t length = std::uniform_int_distribution<size_t>(knobs.stringMin, std::max(knobs.stringMin, knobs.stringMax))(random);
+            length = std::min(length, maxLength);
+            std::string result(length, 'a');
+            for (auto& c : result) {
+                c = alphabet[random() % (sizeof(alphabet) - 1)];
+            }
+            return result;
+        }
+
+        float number() {
+            return std::uniform_real_distribution<float>(-1000.0f, 1000.0f)(random);
+        }
+
+        // Room for an inline char field: up to the next member of its struct.
+        size_t inlineCapacity(const StructMember& member, const std::shared_ptr<StructDefinition>& parentStruct) {
+            size_t next = parentStruct->getFixedSize() > member.offset ? parentStruct->getFixedSize() : member.offset + 16;
+            for (const auto& other : parentStruct->getMembers()) {
+                if (other.offset > member.offset && other.offset < next) {
+                    next = other.offset;
+                }
+            }
+            return next - member.offset;
+        }
+
+        void writeStruct(const std::string& structName);
+        void writeMember(const StructMember& member, const std::shared_ptr<StructDefinition>& parentStruct, bool arrayEntry = false);
+
+    public:
+        CorpusWriter(const Catalog& catalog, const Knobs& knobs, uint64_t seed)
+            : catalog(catalog), knobs(knobs), random(seed), offsetManager(image) {
+        }
+
+        void write(const FileTypeInfo* fileType) {
+            const VersionedFileTypeInfo* versionedInfo = catalog.getVersionedFileTypeInfo(fileType);
+            const std::vector<std::string>& structTypes = versionedInfo ? versionedInfo->structTypes : fileType->structTypes;
+            size_t secondaryOffsetStart = versionedInfo ? versionedInfo->secondaryOffsetStart : fileType->secondaryOffsetStart;
+
+            image.extend(secondaryOffsetStart);
+            offsetManager.setPrimaryOffset(0);
+            offsetManager.setSecondaryOffset(secondaryOffsetStart);
+            for (const auto& structType : structTypes) {
+                writeStruct(structType);
+            }
+        }
+
+        const std::vector<char>& getBytes() const {
+            return image.getBytes();
+        }
+
+        size_t getConflicts() const {
+            return image.conflicts;
+        }
+    };
+
+    void CorpusWriter::writeStruct(const std::string& structName) {
+        auto structDef = catalog.getStruct(structName);
+        if (!structDef) {
+            return;
+        }
+        depth++;
+
+        size_t previousStructBaseOffset = currentStructBaseOffset;
+        if (secOffsetStruct) {
+            structBaseOffsetStack.push(previousStructBaseOffset);
+            currentStructBaseOffset = offsetManager.getSecondaryOffset();
+            if (!processingArrayElement) {
+                offsetManager.setSecondaryOffset(offsetManager.getSecondaryOffset() + structDef->getFixedSize());
+            }
+        }
+
+        size_t structStartOffset = offsetManager.getPrimaryOffset();
+        for (const auto& member : structDef->getMembers()) {
+            if (processingArrayElement) {
+                offsetManager.setPrimaryOffset(structStartOffset);
+            }
+            writeMember(member, structDef);
+        }
+
+        if (secOffsetStruct) {
+            if (!structBaseOffsetStack.empty()) {
+                currentStructBaseOffset = structBaseOffsetStack.top();
+                structBaseOffsetStack.pop();
+            }
+            else {
+                currentStructBaseOffset = 0;
+            }
+        }
+        else {
+            currentStructBaseOffset = previousStructBaseOffset;
+        }
+        depth--;
+    }
+
+    void CorpusWriter::writeMember(const StructMember& member, const std::shared_ptr<StructDefinition>& parentStruct, bool arrayEntry) {
+        const TypeDefinition* typeDef = catalog.getType(member.typeName);
+        if (!typeDef) {
+            return;
+        }
+        size_t originalSecondaryOffset = offsetManager.getSecondaryOffset();
+        size_t arrayStructOffset = offsetManager.getPrimaryOffset();
+
+        if (member.typeName == "array") {
+            size_t arrayStartOffset;
+            if (secOffsetStruct) {
+                if (processingArrayElement) {
+                    arrayStartOffset = arrayStructOffset + member.offset;
+                }
+                else if (isInsideNullable) {
+                    arrayStartOffset = startNullableOffset + member.offset;
+                }
+                else {
+                    arrayStartOffset = currentStructBaseOffset + member.offset;
+                }
+            }
+            else if (member.useSecondaryOffset) {
+                arrayStartOffset = member.offset;
+            }
+            else {
+                arrayStartOffset = currentStructBaseOffset + member.offset;
+            }
+
+            uint32_t count = arrayCount();
+            offsetManager.setPrimaryOffset(arrayStartOffset);
+            if (offsetManager.claimPrimary<uint32_t>(count > 0 ? 1 : 0) == 0) {
+                count = 0;
+            }
+            else if (count == 0) {
+                count = std::max<uint32_t>(1, knobs.arrayMin);
+            }
+
+            bool useSecondaryForElements = secOffsetStruct || !processingArrayElement;
+            size_t arrayDataOffset = useSecondaryForElements ?
+                offsetManager.getSecondaryOffset() :
+                offsetManager.getPrimaryOffset();
+
+            if (count == 0) {
+                return;
+            }
+            uint32_t limit = std::max<uint32_t>(1, std::max(knobs.arrayMin, knobs.arrayMax));
+            if (member.countOffset > 0) {
+                count = offsetManager.claimAt<uint32_t>(startNullableOffset + member.offset + member.countOffset, count, limit);
+            }
+            else {
+                count = offsetManager.claimPrimary<uint32_t>(count, limit);
+            }
+
+            const TypeDefinition* elementType = catalog.getType(member.elementType);
+            auto structDef = catalog.getStruct(member.elementType);
+            if (structDef) {
+                size_t elementSize = structDef->getFixedSize();
+                size_t elementBaseOffset = offsetManager.getPrimaryOffset();
+                offsetManager.setSecondaryOffset(originalSecondaryOffset + structDef->getFixedSize() * count);
+
+                for (uint32_t i = 0; i < count; i++) {
+                    if (useSecondaryForElements) {
+                        offsetManager.setPrimaryOffset(arrayDataOffset);
+                        bool oldSecOffsetStruct = secOffsetStruct;
+                        secOffsetStruct = true;
+                        processingArrayElement = true;
+                        writeStruct(member.elementType);
+                        secOffsetStruct = oldSecOffsetStruct;
+                        arrayDataOffset += structDef->getFixedSize();
+                    }
+                    else {
+                        offsetManager.setPrimaryOffset(elementBaseOffset);
+                        processingArrayElement = true;
+                        writeStruct(member.elementType);
+                        elementBaseOffset += elementSize;
+                    }
+                }
+            }
+            else if (elementType) {
+                bool useSecondaryForValues = !secOffsetStruct && !processingArrayElement;
+                size_t elementBaseOffset = useSecondaryForValues ?
+                    offsetManager.getSecondaryOffset() :
+                    offsetManager.getPrimaryOffset();
+                if (useSecondaryForValues) {
+                    offsetManager.setSecondaryOffset(originalSecondaryOffset + count * elementType->size);
+                }
+
+                for (uint32_t i = 0; i < count; i++) {
+                    if (useSecondaryForValues) {
+                        offsetManager.setPrimaryOffset(elementBaseOffset);
+                        elementBaseOffset += elementType->size;
+                    }
+                    StructMember elementMember("entry", member.elementType, offsetManager.getPrimaryOffset(), useSecondaryForValues);
+                    writeMember(elementMember, parentStruct, true);
+                    if (!useSecondaryForValues) {
+                        offsetManager.advancePrimary(elementType->size);
+                    }
+                }
+            }
+            processingArrayElement = false;
+            return;
+        }
+
+        if (secOffsetStruct) {
+            if (processingArrayElement) {
+                offsetManager.setPrimaryOffset(arrayStructOffset + member.offset);
+            }
+            else {
+                offsetManager.setPrimaryOffset(currentStructBaseOffset + member.offset);
+            }
+        }
+        else if (member.useSecondaryOffset) {
+            offsetManager.setPrimaryOffset(member.offset);
+        }
+        else {
+            offsetManager.setPrimaryOffset(currentStructBaseOffset + member.offset);
+        }
+
+        switch (typeDef->type) {
+        case DataType::BOOL:
+            offsetManager.writePrimary<bool>(random() % 2 == 0);
+            break;
+        case DataType::INT:
+            offsetManager.writePrimary<int>(static_cast<int>(random() % 2001) - 1000);
+            break;
+        case DataType::FLOAT:
+            offsetManager.writePrimary<float>(number());
+            break;
+        case DataType::GUID:
+            offsetManager.writePrimary<uint32_t>(static_cast<uint32_t>(random()));
+            offsetManager.writePrimary<uint16_t>(static_cast<uint16_t>(random()));
+            offsetManager.writePrimary<uint16_t>(static_cast<uint16_t>(random()));
+            offsetManager.writePrimary<uint64_t>(random());
+            break;
+        case DataType::VECTOR2:
+            offsetManager.writePrimary<float>(number());
+            offsetManager.writePrimary<float>(number());
+            break;
+        case DataType::VECTOR3:
+            for (int i = 0; i < 3; i++) offsetManager.writePrimary<float>(number());
+            break;
+        case DataType::QUATERNION:
+            for (int i = 0; i < 4; i++) offsetManager.writePrimary<float>(number());
+            break;
+        case DataType::KEY:
+        case DataType::CKEYASSET:
+        case DataType::ASSET:
+        case DataType::CHAR_PTR: {
+            // Only zero versus non-zero matters; the text follows in the secondary region.
+            bool present = offsetManager.claimPrimary<uint32_t>(chance() ? 1 : 0) != 0;
+            if (present) {
+                offsetManager.writeString(text(), true);
+            }
+            break;
+        }
+        case DataType::LOCALIZEDASSETSTRING: {
+            bool present = offsetManager.claimPrimary<uint32_t>(chance() ? 1 : 0) != 0;
+            bool withId = offsetManager.claimPrimary<uint32_t>(present && chance() ? 1 : 0) != 0;
+            if (present) {
+                offsetManager.writeString(text(), true);
+                if (withId) {
+                    offsetManager.writeString(text(), true);
+                }
+            }
+            break;
+        }
+        case DataType::CHAR: {
+            size_t capacity = arrayEntry ? 1 : inlineCapacity(member, parentStruct);
+            offsetManager.writeString(capacity > 1 ? text(capacity - 1) : std::string(), false);
+            break;
+        }
+        case DataType::ENUM:
+            offsetManager.writePrimary<uint32_t>(static_cast<uint32_t>(random() % 8));
+            break;
+        case DataType::UINT8:
+            offsetManager.writePrimary<uint8_t>(static_cast<uint8_t>(random()));
+            break;
+        case DataType::UINT16:
+            offsetManager.writePrimary<uint16_t>(static_cast<uint16_t>(random()));
+            break;
+        case DataType::UINT32:
+            offsetManager.writePrimary<uint32_t>(static_cast<uint32_t>(random()));
+            break;
+        case DataType::UINT64:
+            offsetManager.writePrimary<uint64_t>(random());
+            break;
+        case DataType::INT64:
+            offsetManager.writePrimary<int64_t>(static_cast<int64_t>(random() % 2000001) - 1000000);
+            break;
+        case DataType::NULLABLE: {
+            size_t startOffset = offsetManager.getPrimaryOffset();
+            auto targetStruct = typeDef->targetType.empty() ? nullptr : catalog.getStruct(typeDef->targetType);
+            bool wanted = targetStruct && depth <= knobs.maxDepth && chance();
+            bool present = offsetManager.claimPrimary<uint32_t>(wanted ? 1 : 0) != 0 && targetStruct;
+            if (present) {
+                startNullableOffset = offsetManager.getSecondaryOffset();
+
+                bool oldSecOffsetStruct = secOffsetStruct;
+                size_t oldStructBaseOffset = currentStructBaseOffset;
+                bool oldProcessingArrayElement = processingArrayElement;
+                secOffsetStruct = true;
+                processingArrayElement = true;
+                isInsideNullable = true;
+
+                offsetManager.setPrimaryOffset(offsetManager.getSecondaryOffset());
+                offsetManager.setSecondaryOffset(originalSecondaryOffset + targetStruct->getFixedSize());
+                writeStruct(typeDef->targetType);
+
+                processingArrayElement = oldProcessingArrayElement;
+                secOffsetStruct = oldSecOffsetStruct;
+                currentStructBaseOffset = oldStructBaseOffset;
+                isInsideNullable = false;
+            }
+            offsetManager.setPrimaryOffset(startOffset + 4);
+            break;
+        }
+        case DataType::STRUCT: {
+            size_t previousBaseOffset = currentStructBaseOffset;
+            currentStructBaseOffset = offsetManager.getPrimaryOffset();
+            writeStruct(typeDef->targetType);
+            currentStructBaseOffset = previousBaseOffset;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::vector<std::string> splitList(const std::string& list) {
+        std::vector<std::string> out;
+        std::string item;
+        for (char c : list + ",") {
+            if (c == ',' || c == ';' || std::isspace(static_cast<unsigned char>(c))) {
+                if (!item.empty()) out.push_back(item);
+                item.clear();
+            }
+            else {
+                item.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+            }
+        }
+        return out;
+    }
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{ "ReCap synthetic corpus generator" };
+
+    std::string outputDir;
+    size_t count = 10;
+    uint64_t seed = 1;
+    std::string typeList;
+    std::string gameVersion = "5.3.0.103";
+    Knobs knobs;
+
+    app.add_option("--output,-o", outputDir, "Directory to write the corpus into")->required();
+    app.add_option("--count,-n", count, "Files per file type (default 10)");
+    app.add_option("--seed", seed, "Seed; the same seed and options give the same corpus");
+    app.add_option("--types", typeList, "Only these extensions or file names, comma separated (default: all)");
+    app.add_option("--array-min", knobs.arrayMin, "Fewest elements in a present array (default 0)");
+    app.add_option("--array-max", knobs.arrayMax, "Most elements in an array (default 4)");
+    app.add_option("--string-min", knobs.stringMin, "Shortest string (default 4)");
+    app.add_option("--string-max", knobs.stringMax, "Longest string (default 24)");
+    app.add_option("--fill", knobs.fill, "Share of nullables and string pointers that are set, 0 to 1 (default 0.75)");
+    app.add_option("--max-depth", knobs.maxDepth, "Nesting depth beyond which arrays and nullables stay empty (default 8)");
+    app.add_option("--game-version,--gv", gameVersion);
+    CLI11_PARSE(app, argc, argv);
+
+    Catalog catalog;
+    catalog.setGameVersion(gameVersion);
+
+    // Extensions get numbered files; exact-name types (catalog_131) one file each.
+    std::vector<std::pair<std::string, bool>> targets;
+    for (const auto& ext : catalog.getRegisteredExtensions()) {
+        targets.emplace_back(ext, true);
+    }
+    for (const auto& name : catalog.getRegisteredFileNames()) {
+        targets.emplace_back(name, false);
+    }
+    std::sort(targets.begin(), targets.end());
+
+    std::vector<std::string> wanted = splitList(typeList);
+    auto isWanted = [&](const std::string& target) {
+        if (wanted.empty()) return true;
+        std::string bare = target[0] == '.' ? target.substr(1) : target;
+        std::transform(bare.begin(), bare.end(), bare.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return std::find(wanted.begin(), wanted.end(), bare) != wanted.end() ||
+            std::find(wanted.begin(), wanted.end(), target) != wanted.end();
+    };
+
+    std::error_code ec;
+    fs::create_directories(outputDir, ec);
+
+    size_t files = 0;
+    uint64_t bytes = 0;
+    size_t conflicted = 0;
+    for (const auto& [target, isExtension] : targets) {
+        if (!isWanted(target)) continue;
+
+        std::string bare = target[0] == '.' ? target.substr(1) : target;
+        fs::path dir = fs::path(outputDir) / bare;
+        fs::create_directories(dir, ec);
+
+        size_t perType = isExtension ? count : std::min<size_t>(count, 1);
+        for (size_t i = 0; i < perType; i++) {
+            fs::path path = isExtension ? dir / fmt::format("{}_{:06}{}", bare, i, target) : dir / target;
+            const FileTypeInfo* fileType = catalog.findFileType(path.string());
+            if (!fileType) continue;
+
+            uint64_t fileSeed = xxh64(target, seed ^ (static_cast<uint64_t>(i) * 0x9E3779B97F4A7C15ULL));
+            CorpusWriter writer(catalog, knobs, fileSeed);
+            writer.write(fileType);
+            if (writer.getConflicts() > 0) {
+                conflicted++;
+                std::cerr << "Warning: " << path << " has " << writer.getConflicts() << " overlapping byte(s)\n";
+            }
+
+            const std::vector<char>& data = writer.getBytes();
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!out) {
+                std::cerr << "Error: cannot write " << path << "\n";
+                return 1;
+            }
+            files++;
+            bytes += data.size();
+        }
+    }
+
+    std::cout << fmt::format("Wrote {} file(s), {:.1f} MB, into {}\n", files, bytes / (1024.0 * 1024.0), outputDir);
+    if (conflicted > 0) {
+        std::cout << conflicted << " file(s) have overlapping layouts and may not read back as written\n";
+    }
+    return 0;
+}
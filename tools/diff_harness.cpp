@@ -0,0 +1,426 @@
+// Differential check of every way recap_parser can feed and render a file
+// against the reference path: Parser::parse() reading the file itself and the
+// XML or YAML exporter saving straight to disk.
+//
+//   recap_diff [--format xml|yaml|both] [--variants memory,mmap,...] [--keep <dir>]
+//              [--max-reports N] [--game-version V] <dir>...
+//
+// Each variant decodes the file twice: once as in production, giving the
+// output bytes and field/string counts, and once with the parse trace on,
+// giving the event stream (every decoded value with its primary and secondary
+// offset). Both must match the reference exactly. A divergence is reported
+// once per file, variant and format, cut down to the first event or output byte that
+// differs, with the offsets and schema path of that event and the events
+// leading up to it. With --keep, the input, both outputs and both event
+// streams are saved for a closer look.
+//
+// The directories can be a recap_corpus_gen corpus, a real AssetData_Binary
+// tree, or both. Exit code 1 means at least one divergence.
+
+#include <CLI/CLI.hpp>
+
+#include "catalog.h"
+#include "package.h"
+#include "bulk_reader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+namespace {
+    struct Outcome {
+        bool parsed = false;
+        std::string error;
+        std::string output;
+        size_t fields = 0;
+        size_t strings = 0;
+        std::vector<std::string> events;
+    };
+
+    // Feeds one file to a parser; false if the input could not be read.
+    using Feed = std::function<bool(Parser& parser, const fs::path& file, bool& parsed)>;
+
+    struct Variant {
+        std::string name;
+        Feed feed;
+        // Renders in memory, as the pipeline, --stats and package paths do.
+        bool toString = true;
+        // Runs without an exporter, so only counts and events are compared.
+        bool noExport = false;
+    };
+
+    std::vector<std::string> readLines(std::FILE* file) {
+        std::vector<std::string> lines;
+        std::string line;
+        int c;
+        std::rewind(file);
+        while ((c = std::fgetc(file)) != EOF) {
+            if (c == '\n') {
+                lines.push_back(std::move(line));
+                line.clear();
+            }
+            else {
+                line += static_cast<char>(c);
+            }
+        }
+        if (!line.empty()) lines.push_back(std::move(line));
+        return lines;
+    }
+
+    bool readFile(const fs::path& path, std::string& out) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        out = buffer.str();
+        return true;
+    }
+
+    Outcome run(const Catalog& catalog, const Variant& variant, const fs::path& file, const std::string& format,
+        const fs::path& workDir, bool traced) {
+        Outcome outcome;
+        fs::path tracePath = workDir / "events.trace";
+        fs::path outPath = workDir / ("reference." + format);
+        {
+            std::unique_ptr<ParseTraceLog> trace;
+            if (traced) trace = std::make_unique<ParseTraceLog>(tracePath.string());
+
+            Parser parser(catalog, file.string(), true, false, variant.noExport ? "none" : format);
+            parser.setTraceLog(trace.get());
+            try {
+                if (!variant.feed(parser, file, outcome.parsed)) {
+                    outcome.error = "could not read the input";
+                    return outcome;
+                }
+            }
+            catch (const std::exception& e) {
+                outcome.parsed = false;
+                outcome.error = e.what();
+            }
+            outcome.fields = parser.getFieldsDecoded();
+            outcome.strings = parser.getStringsRead();
+
+            if (outcome.parsed && !variant.noExport && !traced) {
+                if (variant.toString) {
+                    parser.exportToString(outcome.output);
+                }
+                else {
+                    parser.exportToFile(outPath.string());
+                    readFile(outPath, outcome.output);
+                }
+            }
+        }
+
+        if (traced) {
+            std::FILE* text = std::tmpfile();
+            if (text && ParseTraceLog::decode(tracePath.string(), text, true)) {
+                // Lines starting with # name the file, not an event.
+                for (auto& line : readLines(text)) {
+                    if (line.rfind("#", 0) != 0) outcome.events.push_back(std::move(line));
+                }
+            }
+            if (text) std::fclose(text);
+        }
+        return outcome;
+    }
+
+    // "(primary, secondary)    parse_member_float(speed, 1.00000)" -> offsets,
+    // depth and the name the event is about.
+    struct Event {
+        std::string offsets;
+        size_t depth = 0;
+        std::string name;
+    };
+
+    Event parseEvent(const std::string& line) {
+        Event event;
+        size_t body = 0;
+        if (!line.empty() && line[0] == '(') {
+            size_t close = line.find(") ");
+            if (close != std::string::npos) {
+                event.offsets = line.substr(0, close + 1);
+                body = close + 2;
+            }
+        }
+        size_t text = line.find_first_not_of(' ', body);
+        if (text == std::string::npos) return event;
+        event.depth = (text - body) / 4;
+
+        size_t open = line.find('(', text);
+        if (open == std::string::npos) return event;
+        size_t end = line.find_first_of(",)", open + 1);
+        event.name = line.substr(open + 1, end == std::string::npos ? std::string::npos : end - open - 1);
+        // parse_struct(Name, [3]) is element 3 of an array of Name.
+        size_t element = line.find(", [", open);
+        if (line.compare(text, 13, "parse_struct(") == 0 && element != std::string::npos) {
+            event.name += line.substr(element + 2, line.find(']', element) - element - 1);
+        }
+        return event;
+    }
+
+    // Names of the enclosing structs, arrays and members of events[index].
+    std::string schemaPath(const std::vector<std::string>& events, size_t index) {
+        std::vector<std::string> stack;
+        for (size_t i = 0; i <= index && i < events.size(); i++) {
+            Event event = parseEvent(events[i]);
+            stack.resize(std::min(stack.size(), event.depth));
+            while (stack.size() < event.depth) stack.emplace_back("?");
+            stack.push_back(event.name);
+        }
+        std::string path;
+        for (const auto& name : stack) {
+            if (!path.empty()) path += '/';
+            path += name;
+        }
+        return path;
+    }
+
+    struct Report {
+        std::string text;
+        std::string referenceOutput;
+        std::string variantOutput;
+        std::vector<std::string> referenceEvents;
+        std::vector<std::string> variantEvents;
+    };
+
+    std::string lineAt(const std::string& text, size_t offset, size_t& lineNumber, size_t& column) {
+        size_t start = text.rfind('\n', offset == 0 ? 0 : offset - 1);
+        start = start == std::string::npos ? 0 : start + 1;
+        size_t end = text.find('\n', offset);
+        lineNumber = static_cast<size_t>(std::count(text.begin(), text.begin() + start, '\n')) + 1;
+        column = offset - start + 1;
+        return text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+
+    // Empty if the variant matches the reference.
+    std::string compare(const Outcome& reference, const Outcome& variant, const Outcome& referenceTrace,
+        const Outcome& variantTrace, bool compareOutput) {
+        std::string out;
+        if (reference.parsed != variant.parsed) {
+            return fmt::format("  parse {} where the reference {}{}\n", variant.parsed ? "succeeded" : "failed",
+                reference.parsed ? "succeeded" : "failed", variant.error.empty() ? "" : ": " + variant.error);
+        }
+
+        const auto& expected = referenceTrace.events;
+        const auto& actual = variantTrace.events;
+        size_t common = std::min(expected.size(), actual.size());
+        size_t first = 0;
+        while (first < common && expected[first] == actual[first]) first++;
+        if (first < expected.size() || first < actual.size()) {
+            const auto& path = first < expected.size() ? expected : actual;
+            Event event = parseEvent(path[first]);
+            out += fmt::format("  event {} of {} differs at {} in {}\n", first, expected.size(),
+                event.offsets.empty() ? "(offsets not traced)" : event.offsets, schemaPath(path, first));
+            for (size_t i = first > 3 ? first - 3 : 0; i < first; i++) {
+                out += fmt::format("      {}\n", expected[i]);
+            }
+            out += fmt::format("    - {}\n", first < expected.size() ? expected[first] : "<end of events>");
+            out += fmt::format("    + {}\n", first < actual.size() ? actual[first] : "<end of events>");
+            return out;
+        }
+
+        if (reference.fields != variant.fields || reference.strings != variant.strings) {
+            return fmt::format("  decoded {} field(s) and {} string(s), the reference {} and {}\n",
+                variant.fields, variant.strings, reference.fields, reference.strings);
+        }
+
+        if (compareOutput && reference.output != variant.output) {
+            const auto& a = reference.output;
+            const auto& b = variant.output;
+            size_t at = 0;
+            while (at < a.size() && at < b.size() && a[at] == b[at]) at++;
+            size_t line = 0;
+            size_t column = 0;
+            std::string expectedLine = lineAt(a, std::min(at, a.size()), line, column);
+            std::string actualLine = lineAt(b, std::min(at, b.size()), line, column);
+            out += fmt::format("  output differs at byte {} (line {}, column {}); {} bytes, the reference {}\n",
+                at, line, column, b.size(), a.size());
+            out += fmt::format("    - {}\n    + {}\n", expectedLine, actualLine);
+        }
+        return out;
+    }
+
+    void keep(const fs::path& dir, const fs::path& file, const std::string& label, const Outcome& reference,
+        const Outcome& variant, const Outcome& referenceTrace, const Outcome& variantTrace) {
+        fs::path target = dir / label;
+        std::error_code ec;
+        fs::create_directories(target, ec);
+        fs::copy_file(file, target / file.filename(), fs::copy_options::overwrite_existing, ec);
+        auto save = [&](const std::string& name, const std::string& text) {
+            std::ofstream(target / name, std::ios::binary) << text;
+        };
+        auto join = [](const std::vector<std::string>& lines) {
+            std::string text;
+            for (const auto& line : lines) text += line + "\n";
+            return text;
+        };
+        save("reference.out", reference.output);
+        save("variant.out", variant.output);
+        save("reference.events", join(referenceTrace.events));
+        save("variant.events", join(variantTrace.events));
+    }
+}
+
+int main(int argc, char** argv) {
+    CLI::App app{ "ReCap differential decode check" };
+
+    std::vector<std::string> dirs;
+    std::string format = "both";
+    std::string variantList;
+    std::string keepDir;
+    size_t maxReports = 20;
+    std::string gameVersion = "5.3.0.103";
+
+    app.add_option("dirs", dirs, "Directories to check, e.g. a recap_corpus_gen corpus or real game data")->required();
+    app.add_option("--format", format, "Exporter to check: xml, yaml or both (default both)");
+    app.add_option("--variants", variantList, "Comma separated variants to run (default all): memory, mmap, chunked, bulk, no-export");
+    app.add_option("--keep", keepDir, "Save the input, outputs and event streams of each divergence here");
+    app.add_option("--max-reports", maxReports, "Stop after this many divergences (default 20)");
+    app.add_option("--game-version,--gv", gameVersion);
+    CLI11_PARSE(app, argc, argv);
+
+    std::vector<std::string> formats;
+    if (format == "both") formats = { "xml", "yaml" };
+    else if (format == "xml" || format == "yaml") formats = { format };
+    else {
+        std::cerr << "Error: --format must be xml, yaml or both\n";
+        return 2;
+    }
+
+    BulkReader bulkReader;
+    const Variant reference{ "reference", [](Parser& parser, const fs::path&, bool& parsed) {
+        parsed = parser.parse();
+        return true;
+    }, false };
+    std::vector<Variant> available = {
+        { "memory", [](Parser& parser, const fs::path& file, bool& parsed) {
+            std::vector<char> data;
+            if (!readWholeFile(file.string(), data)) return false;
+            parsed = parser.parse(data.data(), data.size());
+            return true;
+        } },
+        { "mmap", [](Parser& parser, const fs::path& file, bool& parsed) {
+            MappedFile mapped;
+            if (!mapped.open(file.string())) return false;
+            parsed = parser.parse(mapped.getData(), mapped.getSize());
+            return true;
+        } },
+        // An odd chunk size, so values straddle chunk boundaries.
+        { "chunked", [](Parser& parser, const fs::path& file, bool& parsed) {
+            std::vector<char> data;
+            if (!readWholeFile(file.string(), data)) return false;
+            size_t position = 0;
+            parsed = parser.parse([&](char* dst, size_t capacity) {
+                size_t count = std::min({ capacity, data.size() - position, size_t(4093) });
+                std::memcpy(dst, data.data() + position, count);
+                position += count;
+                return count;
+            });
+            return true;
+        } },
+        { "bulk", [&bulkReader](Parser& parser, const fs::path& file, bool& parsed) {
+            std::vector<LoadedFile> batch(1);
+            batch[0].path = file;
+            bulkReader.read(batch);
+            if (!batch[0].loaded) return false;
+            parsed = parser.parse(batch[0].data.data(), batch[0].data.size());
+            return true;
+        } },
+        { "no-export", [](Parser& parser, const fs::path&, bool& parsed) {
+            parsed = parser.parse();
+            return true;
+        }, true, true },
+    };
+
+    std::vector<Variant> variants;
+    if (variantList.empty()) {
+        variants = available;
+    }
+    else {
+        std::stringstream names(variantList);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            auto found = std::find_if(available.begin(), available.end(), [&](const Variant& v) { return v.name == name; });
+            if (found == available.end()) {
+                std::cerr << "Error: unknown variant " << name << "\n";
+                return 2;
+            }
+            variants.push_back(*found);
+        }
+    }
+
+    Catalog catalog;
+    catalog.setGameVersion(gameVersion);
+
+    std::vector<fs::path> files;
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file(ec) && catalog.findFileType(it->path().string())) files.push_back(it->path());
+        }
+        if (ec) std::cerr << "Warning: could not read all of " << dir << ": " << ec.message() << "\n";
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No files of a registered type found\n";
+        return 2;
+    }
+
+    fs::path workDir = fs::temp_directory_path() / fmt::format("recap_diff_{}", getpid());
+    fs::create_directories(workDir);
+    const bool traceCompiled = RECAP_PARSE_TRACE != 0;
+    if (!traceCompiled) {
+        std::cerr << "Warning: built without RECAP_PARSE_TRACE, so event streams are not compared\n";
+    }
+
+    size_t divergences = 0;
+    size_t checks = 0;
+    for (const auto& file : files) {
+        for (const auto& fmtName : formats) {
+            Outcome expected = run(catalog, reference, file, fmtName, workDir, false);
+            Outcome expectedTrace = traceCompiled ? run(catalog, reference, file, fmtName, workDir, true) : Outcome{};
+            for (const auto& variant : variants) {
+                // The no-export walk does not depend on the format.
+                if (variant.noExport && fmtName != formats.front()) continue;
+                checks++;
+                Outcome actual = run(catalog, variant, file, fmtName, workDir, false);
+                Outcome actualTrace = traceCompiled ? run(catalog, variant, file, fmtName, workDir, true) : Outcome{};
+                std::string difference = compare(expected, actual, expectedTrace, actualTrace, !variant.noExport);
+                if (difference.empty()) continue;
+
+                divergences++;
+                std::string label = fmt::format("{}-{}-{}", file.filename().string(), variant.noExport ? "none" : fmtName, variant.name);
+                std::cout << fmt::format("DIVERGENCE {} [{} vs reference, {}]\n{}", file.string(), variant.name,
+                    variant.noExport ? "no export" : fmtName, difference);
+                if (!keepDir.empty()) {
+                    keep(keepDir, file, label, expected, actual, expectedTrace, actualTrace);
+                    std::cout << "  kept in " << (fs::path(keepDir) / label).string() << "\n";
+                }
+                if (divergences >= maxReports) break;
+            }
+            if (divergences >= maxReports) break;
+        }
+        if (divergences >= maxReports) {
+            std::cout << "Stopped after " << maxReports << " divergence(s)\n";
+            break;
+        }
+    }
+
+    std::error_code ec;
+    fs::remove_all(workDir, ec);
+    std::cout << fmt::format("{} file(s), {} check(s), {} divergence(s)\n", files.size(), checks, divergences);
+    return divergences > 0 ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include "tree_walker.h"
+#include <system_error>
+
+#ifndef _WIN32
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+void TreeWalker::walk(const fs::path& root, const Filter& accept, const Visitor& onFile) {
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec) && accept(it->path())) {
+            onFile(it->path());
+        }
+    }
+}
+
+#else
+
+namespace {
+    // Directories waiting to be read, plus how many threads are still reading
+    // one (and so may add more). The walk ends when both reach zero.
+    struct WalkState {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<fs::path> pending;
+        size_t busy = 0;
+    };
+
+    enum class EntryKind { File, Directory, Other };
+
+    // Only for entries whose d_type left the question open.
+    EntryKind statKind(const fs::path& path, unsigned char type) {
+        struct stat info;
+        if (type == DT_UNKNOWN) {
+            if (lstat(path.c_str(), &info) != 0) return EntryKind::Other;
+            if (S_ISDIR(info.st_mode)) return EntryKind::Directory;
+            if (S_ISREG(info.st_mode)) return EntryKind::File;
+            if (!S_ISLNK(info.st_mode)) return EntryKind::Other;
+        }
+        // A symlink counts as the file it points to; linked directories are skipped.
+        if (stat(path.c_str(), &info) != 0) return EntryKind::Other;
+        return S_ISREG(info.st_mode) ? EntryKind::File : EntryKind::Other;
+    }
+
+    void readDirectory(const fs::path& dir, const TreeWalker::Filter& accept, const TreeWalker::Visitor& onFile,
+        std::vector<fs::path>& subdirs) {
+        DIR* handle = opendir(dir.c_str());
+        if (!handle) {
+            return;
+        }
+        while (dirent* entry = readdir(handle)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            fs::path path = dir / name;
+            switch (entry->d_type) {
+            case DT_DIR:
+                subdirs.push_back(std::move(path));
+                continue;
+            case DT_REG:
+                if (accept(path)) onFile(std::move(path));
+                continue;
+            case DT_LNK:
+                // Filter by name first: links of the wrong type never cost a stat.
+                if (!accept(path)) continue;
+                break;
+            case DT_UNKNOWN:
+                break;
+            default:
+                continue;
+            }
+
+            EntryKind kind = statKind(path, entry->d_type);
+            if (kind == EntryKind::Directory) {
+                subdirs.push_back(std::move(path));
+            }
+            else if (kind == EntryKind::File && accept(path)) {
+                onFile(std::move(path));
+            }
+        }
+        closedir(handle);
+    }
+}
+
+void TreeWalker::walk(const fs::path& root, const Filter& accept, const Visitor& onFile) {
+    WalkState state;
+    state.pending.push_back(root);
+
+    auto worker = [&]() {
+        std::vector<fs::path> subdirs;
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (true) {
+            state.changed.wait(lock, [&] { return !state.pending.empty() || state.busy == 0; });
+            if (state.pending.empty()) {
+                return;
+            }
+            fs::path dir = std::move(state.pending.back());
+            state.pending.pop_back();
+            state.busy++;
+            lock.unlock();
+
+            subdirs.clear();
+            readDirectory(dir, accept, onFile, subdirs);
+
+            lock.lock();
+            state.busy--;
+            for (auto& subdir : subdirs) {
+                state.pending.push_back(std::move(subdir));
+            }
+            state.changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif
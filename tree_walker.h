@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+// Recursive directory walk spread over several threads, one directory at a
+// time per thread. On POSIX the entry type comes from readdir's d_type, so
+// only entries the filesystem cannot classify (and symlinks) are stat'ed.
+// Windows falls back to a single-threaded recursive_directory_iterator.
+//
+// Like recursive_directory_iterator with default options, symlinks to files
+// are reported and symlinks to directories are not followed.
+class TreeWalker {
+public:
+    using Filter = std::function<bool(const fs::path&)>;
+    using Visitor = std::function<void(fs::path)>;
+
+private:
+    size_t threadCount;
+
+public:
+    explicit TreeWalker(size_t threadCount)
+        : threadCount(threadCount > 0 ? threadCount : 1) {
+    }
+
+    // Calls onFile for every regular file under root that accept allows,
+    // from the walker threads and in no particular order. accept sees the
+    // path before anything is stat'ed. Returns once the whole tree is done.
+    void walk(const fs::path& root, const Filter& accept, const Visitor& onFile);
+};
@@ -0,0 +1,155 @@
+#include "watch.h"
+#include <iostream>
+#include <unordered_set>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+DirectoryWatcher::~DirectoryWatcher() {
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+#endif
+}
+
+bool DirectoryWatcher::isSupported() {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef __linux__
+
+namespace {
+    constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+}
+
+void DirectoryWatcher::watchTree(const fs::path& root, std::vector<fs::path>* existingFiles) {
+    int wd = inotify_add_watch(inotifyFd, root.c_str(), WATCH_MASK);
+    if (wd >= 0) {
+        watchedDirs[wd] = root;
+    }
+
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root, fs::directory_options::skip_permission_denied, ec);
+        !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_directory(ec)) {
+            int childWd = inotify_add_watch(inotifyFd, it->path().c_str(), WATCH_MASK);
+            if (childWd >= 0) {
+                watchedDirs[childWd] = it->path();
+            }
+        }
+        else if (existingFiles && it->is_regular_file(ec)) {
+            // Written before the watch on its new directory existed.
+            existingFiles->push_back(it->path());
+        }
+    }
+}
+
+bool DirectoryWatcher::start(const fs::path& watchRoot, std::string& error) {
+    root = watchRoot;
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        error = "inotify is unavailable";
+        return false;
+    }
+    watchTree(root, nullptr);
+    if (watchedDirs.empty()) {
+        error = "cannot watch " + root.string();
+        return false;
+    }
+    return true;
+}
+
+bool DirectoryWatcher::drain(std::vector<fs::path>& batch) {
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        if (length == 0) {
+            return true;
+        }
+
+        for (char* p = buffer; p < buffer + length; ) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost, so it is unknown which files changed.
+                std::cerr << "Warning: --watch: inotify queue overflowed, rescanning " << root << "\n";
+                watchTree(root, &batch);
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watchedDirs.erase(event->wd);
+                continue;
+            }
+            auto dir = watchedDirs.find(event->wd);
+            if (dir == watchedDirs.end() || event->len == 0) {
+                continue;
+            }
+
+            fs::path path = dir->second / event->name;
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watchTree(path, &batch);
+                }
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                batch.push_back(path);
+            }
+        }
+    }
+}
+
+std::vector<fs::path> DirectoryWatcher::nextBatch(std::chrono::milliseconds quiet) {
+    std::vector<fs::path> batch;
+    pollfd descriptor{ inotifyFd, POLLIN, 0 };
+
+    while (batch.empty()) {
+        if (poll(&descriptor, 1, -1) < 0 && errno != EINTR) {
+            return batch;
+        }
+        if (!drain(batch)) {
+            return batch;
+        }
+    }
+
+    while (poll(&descriptor, 1, static_cast<int>(quiet.count())) > 0) {
+        if (!drain(batch)) {
+            break;
+        }
+    }
+
+    std::unordered_set<std::string> seen;
+    std::vector<fs::path> unique;
+    for (auto& path : batch) {
+        if (seen.insert(path.string()).second) {
+            unique.push_back(std::move(path));
+        }
+    }
+    return unique;
+}
+
+#else
+
+bool DirectoryWatcher::start(const fs::path&, std::string& error) {
+    error = "--watch needs inotify and is only available on Linux";
+    return false;
+}
+
+std::vector<fs::path> DirectoryWatcher::nextBatch(std::chrono::milliseconds) {
+    return {};
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+// Watches a directory tree with inotify and reports files that were written
+// or moved in. Directories created later are picked up as they appear, so the
+// tree is walked only once at startup. Linux only.
+class DirectoryWatcher {
+private:
+    int inotifyFd = -1;
+    fs::path root;
+    std::unordered_map<int, fs::path> watchedDirs;
+
+    void watchTree(const fs::path& root, std::vector<fs::path>* existingFiles);
+    // Reads pending events, adding changed files to batch; false on error.
+    bool drain(std::vector<fs::path>& batch);
+
+public:
+    DirectoryWatcher() = default;
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    ~DirectoryWatcher();
+
+    static bool isSupported();
+
+    bool start(const fs::path& root, std::string& error);
+
+    // Waits for a change, then keeps collecting until nothing has changed for
+    // `quiet`, so a burst of writes becomes one batch. Each path appears once.
+    // If the kernel dropped events, every file under the root is in the batch.
+    std::vector<fs::path> nextBatch(std::chrono::milliseconds quiet);
+};
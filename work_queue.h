@@ -0,0 +1,223 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Blocking FIFO with a fixed capacity: producers wait while it is full, which
+// caps how far they can run ahead of the consumers.
+template<typename T>
+class BoundedQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity(capacity > 0 ? capacity : 1) {
+    }
+
+    // Returns false if the queue was closed before the item could be added.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Waits for at least one item, then takes up to max of what is queued.
+    // Returns false once the queue is closed and drained.
+    bool popSome(std::vector<T>& out, size_t max) {
+        out.clear();
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        while (!items.empty() && out.size() < max) {
+            out.push_back(std::move(items.front()));
+            items.pop_front();
+        }
+        notFull.notify_all();
+        return !out.empty();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+// Fixed set of threads running one function over submitted items.
+template<typename T>
+class WorkerPool {
+private:
+    BoundedQueue<T> queue;
+    std::function<void(T&)> work;
+    std::vector<std::thread> threads;
+
+    std::mutex idleMutex;
+    std::condition_variable idle;
+    size_t pending = 0;
+
+    void run() {
+        T item;
+        while (queue.pop(item)) {
+            work(item);
+            std::lock_guard<std::mutex> lock(idleMutex);
+            if (--pending == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+
+public:
+    WorkerPool(size_t threadCount, size_t queueCapacity, std::function<void(T&)> work)
+        : queue(queueCapacity), work(std::move(work)) {
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        queue.close();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Blocks while the queue is full.
+    void submit(T item) {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            pending++;
+        }
+        queue.push(std::move(item));
+    }
+
+    // Waits until every submitted item has been processed.
+    void wait() {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+// One stage of a pipeline: threads taking items from a bounded input queue.
+// A full queue blocks push, so a fast stage cannot run far ahead of the
+// next. Records how long its threads spent working, for tuning the split.
+template<typename T>
+class PipelineStage {
+private:
+    std::string name;
+    BoundedQueue<T> queue;
+    std::function<void(T&)> work;
+    std::function<void(std::vector<T>&)> batchWork;
+    size_t maxBatch = 1;
+    std::vector<std::thread> threads;
+    std::atomic<long long> busyNanos{ 0 };
+    std::atomic<size_t> itemCount{ 0 };
+
+    void run() {
+        std::vector<T> batch;
+        while (queue.popSome(batch, maxBatch)) {
+            auto started = std::chrono::steady_clock::now();
+            if (batchWork) {
+                batchWork(batch);
+            }
+            else {
+                work(batch.front());
+            }
+            busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+            itemCount += batch.size();
+        }
+    }
+
+    void start(size_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+public:
+    PipelineStage(std::string name, size_t threadCount, size_t queueCapacity, std::function<void(T&)> work)
+        : name(std::move(name)), queue(queueCapacity), work(std::move(work)) {
+        start(threadCount);
+    }
+
+    // Each call gets whatever is queued, up to maxBatch items, so work that
+    // is cheaper in bulk batches up under load without waiting when idle.
+    PipelineStage(std::string name, size_t threadCount, size_t queueCapacity, size_t maxBatch,
+        std::function<void(std::vector<T>&)> batchWork)
+        : name(std::move(name)), queue(queueCapacity), batchWork(std::move(batchWork)), maxBatch(maxBatch > 0 ? maxBatch : 1) {
+        start(threadCount);
+    }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    ~PipelineStage() {
+        finish();
+    }
+
+    void push(T item) {
+        queue.push(std::move(item));
+    }
+
+    // Lets the threads drain the queue, then joins them. Finish stages in
+    // order, so that every item pushed into the next stage is accepted.
+    void finish() {
+        queue.close();
+        for (auto& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    const std::string& getName() const { return name; }
+    size_t getThreadCount() const { return threads.size(); }
+    size_t getItemCount() const { return itemCount; }
+
+    // Share of the stage's thread time spent working over wallSeconds.
+    double utilisation(double wallSeconds) const {
+        if (wallSeconds <= 0 || threads.empty()) {
+            return 0;
+        }
+        return busyNanos / 1e9 / (wallSeconds * threads.size());
+    }
+};